@@ -53,7 +53,8 @@
 #include <unistd.h> //sleep
 #include <ncurses.h>
 #include <signal.h>
-#include <pthread.h>
+#include <errno.h>
+#include <time.h>
 #include <sys/select.h>
 #include <sys/ioctl.h>
 #include "../wifi_scan.h"
@@ -70,8 +71,6 @@
 
 #define swapxy(X,Y) ({ typeof(X) tmp = (X); (X) = (Y); (Y) = tmp; })
 
-#define INIT_BSS_INFOS 1024
-
 #define WHITE_ON_BLACK 10
 
 #define SCREEN_REFRESH_HZ 60
@@ -82,7 +81,7 @@ WINDOW *wintext = NULL, *wingraph = NULL, *winwifiarea = NULL, *winrfbar = NULL;
 static bool rotating_bar = true;
 int stdscr_lines, stdscr_columns, graph_lines, graph_columns, text_lines, text_columns;
 int  winstart = 0;
-volatile int status, i;
+int status, i;
 
 class smart_window {
 	friend class screen_window;
@@ -145,7 +144,6 @@ class text_window  *wtext = NULL;
 class graph_window *wgraph = NULL;
 class rfbar_window *wrfbar = NULL;
 
-int BSS_INFOS=INIT_BSS_INFOS; //the maximum amounts of APs (Access Points) we want to store
 static sigset_t sigwinch_set;
 
 void smart_window::resize(void) {
@@ -242,13 +240,16 @@ bool ascending = true;
 void Usage(char **argv);
 
 struct wifi_scan *wifi=NULL;    //this stores all the library information
-struct bss_info  *bss = NULL; //this is where we are going to keep informatoin about APs (Access Points)
+struct bss_list scan_list = {};  //the library grows it to hold as many APs (Access Points) as there are
+struct bss_list next_list = {};  //the next scan goes here, compared with scan_list and then swapped with it
+struct bss_info  *bss = NULL; //this is where we are going to keep informatoin about APs (Access Points), scan_list.bss
 char mac[BSSID_STRING_LENGTH];  //a placeholder where we convert BSSID to printable hardware mac address
 char mac2[BSSID_STRING_LENGTH];  //a placeholder where we convert BSSID to printable hardware mac address
 
-volatile bool RF_scanning = false;
-volatile bool RF_scan_progress = false;
-volatile int scanner_dots = 0;
+bool RF_scanning = false;
+bool RF_scan_progress = false;
+int scanner_dots = 0;
+int scan_delay_ms = 0; //from the scan pacing, shown in the header
 bool initial_screen = true;
 bool color_mode = false;
 bool resized = false;
@@ -301,6 +302,55 @@ int wifis_per_chan[WIFI_NCHAN + 1];
 int power_per_chan[WIFI_NCHAN + 1][MAX_PER_CHAN];
 int index_per_chan[WIFI_NCHAN + 1][MAX_PER_CHAN];
 
+const char **bss_vendor = NULL; // vendors of bss[], resolved in one batch
+int bss_vendor_size = 0;
+struct vendor_db *local_vendors = NULL; // --vendors-local, consulted first
+
+//resolve the vendors of the first n BSSes with one call
+const char **resolve_vendors(int n)
+{
+	const struct vendor_db *dbs[2];
+	int n_dbs = 0;
+
+	if (n > bss_vendor_size) {
+		bss_vendor = (const char **) realloc (bss_vendor, sizeof (const char *) * n);
+		bss_vendor_size = n;
+	}
+	if (local_vendors)
+		dbs[n_dbs++] = local_vendors;
+	if ((dbs[n_dbs] = vendor_db_current()))
+		n_dbs++;
+	vendor_db_lookup_bss_info(dbs, n_dbs, bss, n, bss_vendor, NULL);
+	return bss_vendor;
+}
+
+//BSSes whose vendor matches --find-vendor are highlighted, by MAC ranges of the local and the main table
+const char *find_vendor = NULL;
+struct vendor_range *find_ranges[2] = { NULL, NULL };
+size_t find_n_ranges[2] = { 0, 0 };
+
+void find_vendor_update(void)
+{
+	const struct vendor_db *dbs[2] = { local_vendors, vendor_db_current() };
+	size_t n;
+
+	for (int i = 0; i < 2; i++) {
+		free(find_ranges[i]);
+		find_ranges[i] = NULL;
+		find_n_ranges[i] = 0;
+		if (!find_vendor || !dbs[i] || (n = vendor_db_search_ranges(dbs[i], find_vendor, NULL, 0)) == 0)
+			continue;
+		if ((find_ranges[i] = (struct vendor_range *) malloc(sizeof (struct vendor_range) * n)) != NULL)
+			find_n_ranges[i] = vendor_db_search_ranges(dbs[i], find_vendor, find_ranges[i], n);
+	}
+}
+
+bool vendor_found(const uint8_t bssid[BSSID_LENGTH])
+{
+	return vendor_ranges_match(find_ranges[0], find_n_ranges[0], bssid) ||
+	       vendor_ranges_match(find_ranges[1], find_n_ranges[1], bssid);
+}
+
 //convert bssid to printable hardware mac address
 char *bssid_to_string(const uint8_t bssid[BSSID_LENGTH], char bssid_string[BSSID_STRING_LENGTH])
 {
@@ -312,9 +362,6 @@ char *bssid_to_string(const uint8_t bssid[BSSID_LENGTH], char bssid_string[BSSID
 
 void initialise()
 {
-	//this is where we are going to keep informatoin about APs (Access Points)
-	bss = (struct bss_info*) malloc (sizeof (struct bss_info) * BSS_INFOS);
-
 	sigemptyset(&sigwinch_set);
 	sigaddset(&sigwinch_set, SIGWINCH);
 }
@@ -353,11 +400,37 @@ static inline int kbhit(void) {
 
 // NOTE END OF INCLUDED SECTION
 
+#define EVENT_KEY  1
+#define EVENT_SCAN 2
+
+//like ioa() above, but also for the wifi_scan descriptor: returns which of events are ready within timeout_ms
+static int wait_events(int timeout_ms, int events)
+{
+	struct timespec ts = { timeout_ms / 1000, (timeout_ms % 1000) * 1000000L };
+	int fd = wifi_scan_get_fd(wifi), ready = 0;
+	fd_set fs;
+
+	FD_ZERO(&fs);
+	if (events & EVENT_KEY)
+		FD_SET(STDIN_FILENO, &fs);
+	if (events & EVENT_SCAN)
+		FD_SET(fd, &fs);
+
+	if (pselect((fd > STDIN_FILENO ? fd : STDIN_FILENO) + 1, &fs, NULL, NULL, &ts, &sigwinch_set) <= 0)
+		return 0;
+
+	if ((events & EVENT_KEY) && FD_ISSET(STDIN_FILENO, &fs))
+		ready |= EVENT_KEY;
+	if ((events & EVENT_SCAN) && FD_ISSET(fd, &fs))
+		ready |= EVENT_SCAN;
+	return ready;
+}
+
 void rfbar_window::repaint (void)
 {
 	const char *progress = "\\|/-";
-	if (RF_scan_progress && READ_ONCE(RF_scanning)) {
-		int prog = READ_ONCE(scanner_dots);
+	if (RF_scan_progress && RF_scanning) {
+		int prog = scanner_dots;
 		if (!prog)
 			return;
 		int dots = prog / (SCREEN_REFRESH_HZ / DOT_TICK_HZ);
@@ -380,10 +453,15 @@ void text_window::wifiarea_update (WINDOW *winwifiarea)
 	int colourpair, wifipc, chan;
 	// int nrwifi = getnrows(winwifiarea), ncwifi = getncols(winwifiarea);
 	int nrwifi = getnrows(wtext->window) - 4, ncwifi = getncols(wtext->window);
-	int repaint_end = MIN(status, BSS_INFOS);
+	int repaint_end = MIN(status, startline + nrwifi + 1);
+	const char **vendor;
 
 	// getmaxyx(winwifiarea, nrwifi, ncwifi);
 
+	if (repaint_end <= 0)
+		return;
+	vendor = resolve_vendors(repaint_end);
+
 	for (int i = 0; i < repaint_end; i++) {
 		bool flip = i - startline > nrwifi;
 
@@ -398,7 +476,7 @@ void text_window::wifiarea_update (WINDOW *winwifiarea)
 		default:
 			colourpair = 3; break;
 		}
-		wattron(winwifiarea, ( color_mode ? COLOR_PAIR(colourpair + 3) : 0 ) | A_BOLD);
+		wattron(winwifiarea, ( color_mode ? COLOR_PAIR(colourpair + 3) : 0 ) | A_BOLD | ( vendor_found(bss[i].bssid) ? A_REVERSE : 0 ));
 		mvwnprintw(winwifiarea, i - (flip ? nrwifi - 4: 0) - startline, flip ? 100 : 0, ncwifi, "%2d %s %20.20s   %3d dBm   %u MHz      %3d   %5d ms ago %3d %2d %d  %s ",
 		   i,
 		   bssid_to_string(bss[i].bssid, mac), 
@@ -408,12 +486,12 @@ void text_window::wifiarea_update (WINDOW *winwifiarea)
 		   channel_from_freq_mhz(bss[i].frequency),
 		   bss[i].seen_ms_ago,
 		   chan, wifipc, colourpair,
-		   get_vendor_by_mac_hashtable(bssid_to_string(bss[i].bssid, mac))
+		   vendor[i]
 		);
 		if (bss[i].status == BSS_ASSOCIATED)
 			waddch(winwifiarea, ACS_DIAMOND);
 		waddch(winwifiarea, '\n');
-		wattroff(winwifiarea, ( color_mode ? COLOR_PAIR(colourpair + 3) : 0 ) | A_BOLD);
+		wattroff(winwifiarea, ( color_mode ? COLOR_PAIR(colourpair + 3) : 0 ) | A_BOLD | A_REVERSE);
 	}
 }
 
@@ -441,9 +519,8 @@ void text_window::repaint(void)
 		// return;
 	// fprintf(stderr, "window=%8p\n", window);
 
-	//wifi_scan_all returns the number of found stations, it may be greater than BSS_INFOS that's why we test for both in the loop
 	wclear(window);
-	wnprintw(window, nc - 2, "\n  n APs=%d SK=%c.%c %dx%d (%dx%d)\n", status, (char)sort_key, ascending ? 'a' : 'd', nr, nc, nrwifi, ncwifi);
+	wnprintw(window, nc - 2, "\n  n APs=%d SK=%c.%c %dx%d (%dx%d) next scan %dms\n", status, (char)sort_key, ascending ? 'a' : 'd', nr, nc, nrwifi, ncwifi, scan_delay_ms);
 	wnprintw(window, nc - 2, "  %2s %17s %20.20s    %s  frequency  channel    seen ms ago   status  vendor\n",
 				"N", "MAC", "SSID", "signal");
 	wifiarea_update(winwifiarea);
@@ -540,7 +617,7 @@ void init_stats(void) {
 		}
 	}
 
-	for (i = 0; i < status && i < BSS_INFOS; ++i) {
+	for (i = 0; i < status; ++i) {
 		int line = 1 + index_from_freq_mhz(bss[i].frequency);
 		index_per_chan[line][wifis_per_chan[line]] = i;
 		power_per_chan[line][wifis_per_chan[line]] = bss[i].signal_mbm/100;
@@ -555,6 +632,9 @@ int perform_sorting() {
 	if (READ_ONCE(sorted))
 		return sort_key; // nothing to do
 
+	if (sort_key == 'v' && status > 0)
+		resolve_vendors(status);
+
 	for (i = 0; i < status; i++)
 		for (j = i + 1; j < status; j ++)
 			if      (sort_key == 'c' &&  ascending && (bss[i].frequency >  bss[j].frequency ||
@@ -567,10 +647,10 @@ int perform_sorting() {
 				swapxy(bss[i], bss[j]);
 			else if (sort_key == 'm' && !ascending && strncmp(bssid_to_string(bss[i].bssid, mac), bssid_to_string(bss[j].bssid, mac2), BSSID_STRING_LENGTH - 1) < 0)
 				swapxy(bss[i], bss[j]);
-			else if (sort_key == 'v' &&  ascending && strcmp(get_vendor_by_mac_hashtable(bssid_to_string(bss[i].bssid, mac)), get_vendor_by_mac_hashtable(bssid_to_string(bss[j].bssid, mac2))) > 0)
-				swapxy(bss[i], bss[j]);
-			else if (sort_key == 'v' && !ascending && strcmp(get_vendor_by_mac_hashtable(bssid_to_string(bss[i].bssid, mac)), get_vendor_by_mac_hashtable(bssid_to_string(bss[j].bssid, mac2))) < 0)
-				swapxy(bss[i], bss[j]);
+			else if (sort_key == 'v' &&  ascending && strcmp(bss_vendor[i], bss_vendor[j]) > 0)
+				swapxy(bss[i], bss[j]), swapxy(bss_vendor[i], bss_vendor[j]);
+			else if (sort_key == 'v' && !ascending && strcmp(bss_vendor[i], bss_vendor[j]) < 0)
+				swapxy(bss[i], bss[j]), swapxy(bss_vendor[i], bss_vendor[j]);
 			else if (sort_key == 'i' &&  ascending && strcmp(bss[i].ssid, bss[j].ssid) > 0)
 				swapxy(bss[i], bss[j]);
 			else if (sort_key == 'i' && !ascending && strcmp(bss[i].ssid, bss[j].ssid) < 0)
@@ -637,43 +717,227 @@ int process_keypress_event() {
 	return c;
 }
 
-pthread_mutex_t first_scan_mutex;
-volatile bool first_scan_passed = false;
+#define SCAN_RETRY_MS 200
+#define CACHE_REFRESH_MS 100
+//the bounds of the time between scans, the library paces them in between
+#define PACING_MIN_MS 250
+#define PACING_MAX_MS 5000
+//a group is over soon, the link gets the radio back in between
+#define PACING_ROLLING_MIN_MS 50
+#define PACING_ROLLING_MAX_MS 2000
+
+bool cached_mode = false; //--cached: only read what the kernel already has, never trigger a scan
+int max_age_ms = 0;	  //--max-age: with --cached, leave out BSSes not seen for longer
+
+//--channels, --dwell, --probe: nothing set is the full passive sweep
+uint32_t scan_freqs[WIFI_NCHAN];
+const char *scan_ssids[WIFI_SCAN_MAX_SSIDS];
+struct wifi_scan_params scan_params = { scan_freqs, 0, scan_ssids, 0, 0, 0 };
+
+static const struct {
+	const char *name;
+	uint32_t flag;
+} scan_flag_names[] = {
+	{ "low-priority",  WIFI_SCAN_LOW_PRIORITY },
+	{ "low-span",      WIFI_SCAN_LOW_SPAN },
+	{ "low-power",     WIFI_SCAN_LOW_POWER },
+	{ "high-accuracy", WIFI_SCAN_HIGH_ACCURACY },
+	{ "flush",         WIFI_SCAN_FLUSH },
+};
+#define N_SCAN_FLAGS (sizeof(scan_flag_names) / sizeof(scan_flag_names[0]))
+
+//--rolling, --group: a group of channels per scan, merged into one view by the library
+bool rolling_mode = false;
+int rolling_group = 0;
+struct wifi_scan_rolling *rolling = NULL;
+
+struct wifi_scan_pacing pacing;
+
+//the scan runs alongside everything else: triggered here, waited for in wait_events() and collected by scan_collect()
+uint64_t scan_started_ms = 0, next_scan_ms = 0;
+
+static uint64_t now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+
+int scan_start(void)
+{
+	if ((rolling ? wifi_scan_rolling_trigger(rolling) : wifi_scan_trigger_params(wifi, &scan_params)) == -1) {
+		//not permitted to scan, which reading the cache does not need
+		if (errno == EPERM)
+			cached_mode = true;
+		return -1;
+	}
+	RF_scanning = true;
+	scan_started_ms = now_ms();
+	scanner_dots = 0;
+	return 0;
+}
 
-void *wifi_scan_thread(void *arg)
+//a scan which never ends holds the radio: abort it, scan_collect() gets ECANCELED then
+void scan_deadline(void)
 {
-	while (1)
-	{
-		SET_ONCE(RF_scanning);
-		status = wifi_scan_all(wifi, bss, BSS_INFOS);
-		if (!first_scan_passed)	{
-			SET_ONCE(first_scan_passed);
-			pthread_mutex_unlock(&first_scan_mutex);
-		}
-		if (status >= BSS_INFOS) {
-			int new_status = BSS_INFOS;
-			BSS_INFOS = status;
-			bss = (struct bss_info*) realloc (bss, sizeof (struct bss_info) * BSS_INFOS);
-			status = new_status;
-		}
-		CLEAR_ONCE(sorted);
-		WRITE_ONCE(scanner_dots, 0);
-		CLEAR_ONCE(RF_scanning);
-		usleep(500000);
+	if (!RF_scanning || now_ms() - scan_started_ms < WIFI_SCAN_TIMEOUT_MS)
+		return;
+
+	if (wifi_scan_abort(wifi) == 0) {
+		//the same deadline for the abort
+		scan_started_ms = now_ms();
+		return;
 	}
+	//nothing to abort, the end of the scan got lost
+	RF_scanning = false;
+	scanner_dots = 0;
+	scan_delay_ms = wifi_scan_pacing_failed(&pacing, ETIMEDOUT);
+	next_scan_ms = now_ms() + scan_delay_ms;
 }
 
-pthread_t scan_threadID;
+//call when the wifi_scan descriptor is readable: true when bss[] has new results
+bool scan_collect(void)
+{
+	struct bss_diff diff;
+	struct station_info station;
+	int n;
+
+	n = wifi_scan_process(wifi);
+	if (n == 0)
+		return false;
+	if (n < 0) {
+		//aborted (ECANCELED) by us, somebody else or the driver, try again in a while
+		if (errno != ECANCELED)
+			perror("Unable to get scan data");
+		RF_scanning = false;
+		scanner_dots = 0;
+		scan_delay_ms = wifi_scan_pacing_failed(&pacing, errno);
+		next_scan_ms = now_ms() + scan_delay_ms;
+		return false;
+	}
+
+	n = rolling ? wifi_scan_rolling_results(rolling, &next_list) : wifi_scan_results_list(wifi, &next_list);
+	RF_scanning = false;
+	scanner_dots = 0;
+
+	if (n < 0) {
+		perror("Unable to get scan data");
+		scan_delay_ms = wifi_scan_pacing_failed(&pacing, errno);
+		next_scan_ms = now_ms() + scan_delay_ms;
+		return false;
+	}
+	//sooner when much has changed, later when nothing did or when the link is busy
+	bss_diff(scan_list.bss, scan_list.length, next_list.bss, next_list.length, &diff);
+	scan_delay_ms = wifi_scan_pacing_results(&pacing, &diff, n);
+	memset(&station, 0, sizeof(station));
+	scan_delay_ms = wifi_scan_pacing_link(&pacing, wifi_scan_station(wifi, &station) == 1 ? &station : NULL);
+	next_scan_ms = now_ms() + scan_delay_ms;
+
+	//all of them, however many, the list grows as needed
+	swapxy(scan_list, next_list);
+	bss = scan_list.bss;
+	status = n;
+	CLEAR_ONCE(sorted);
+	return true;
+}
+
+//--channels 1,6,11,36: the frequencies of the channels in wifi_channel[]
+int parse_channels(const char *list)
+{
+	char *end;
+
+	scan_params.frequencies_length = 0;
+	do {
+		long chan = strtol(list, &end, 10);
+		int i;
+
+		if (end == list)
+			return -1;
+		for (i = 0; i < (int)WIFI_NCHAN && wifi_channel[i].chan != chan; i++)
+			;
+		if (i == (int)WIFI_NCHAN || scan_params.frequencies_length == (int)WIFI_NCHAN)
+			return -1;
+		scan_freqs[scan_params.frequencies_length++] = wifi_channel[i].freq_mhz;
+		list = end + 1;
+	} while (*end == ',');
+
+	return *end == '\0' ? 0 : -1;
+}
+
+//--scan-flags low-priority,flush: the flags by name
+int parse_scan_flags(const char *list)
+{
+	scan_params.flags = 0;
+	while (*list) {
+		size_t len = strcspn(list, ",");
+		unsigned int i;
+
+		for (i = 0; i < N_SCAN_FLAGS; i++)
+			if (strlen(scan_flag_names[i].name) == len && strncmp(scan_flag_names[i].name, list, len) == 0)
+				break;
+		if (i == N_SCAN_FLAGS)
+			return -1;
+		scan_params.flags |= scan_flag_names[i].flag;
+		list += len;
+		if (*list == ',')
+			list++;
+	}
+	return 0;
+}
+
+//--cached: the BSSes the kernel has now, from the scans of whoever made them
+bool cache_collect(void)
+{
+	int n = wifi_scan_cached_list(wifi, &scan_list, max_age_ms);
+
+	next_scan_ms = now_ms() + CACHE_REFRESH_MS;
+	if (n < 0) {
+		perror("Unable to get cached scan data");
+		return false;
+	}
+	bss = scan_list.bss;
+	status = n;
+	CLEAR_ONCE(sorted);
+	return true;
+}
 
 int main(int argc, char **argv)
 {
 	char *wifi_if = NULL;
+	const char *vendors_file = NULL;
+	uint64_t vendors_generation;
 
 	for (int i = 1; i < argc; i++) {
 		if (strncmp(argv[i], "--dbm-descend", 11) == 0)
 			sort_key = 's', ascending = false;
 		else if (strncmp(argv[i], "--dbm", 5) == 0)
 			sort_key = 's', ascending = true;
+		else if (strcmp(argv[i], "--channels") == 0 && i + 1 < argc) {
+			if (parse_channels(argv[++i]) < 0) {
+				fprintf(stderr, "%s: --channels takes channel numbers from the band plan, e.g. 1,6,11,36\n", argv[0]);
+				exit(1);
+			}
+		}
+		else if (strcmp(argv[i], "--dwell") == 0 && i + 1 < argc)
+			scan_params.dwell_ms = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--scan-flags") == 0 && i + 1 < argc) {
+			if (parse_scan_flags(argv[++i]) < 0) {
+				fprintf(stderr, "%s: --scan-flags takes low-priority,low-span,low-power,high-accuracy,flush\n", argv[0]);
+				exit(1);
+			}
+		}
+		else if (strcmp(argv[i], "--rolling") == 0)
+			rolling_mode = true;
+		else if (strcmp(argv[i], "--group") == 0 && i + 1 < argc)
+			rolling_group = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--probe") == 0 && i + 1 < argc) {
+			if (scan_params.ssids_length == WIFI_SCAN_MAX_SSIDS) {
+				fprintf(stderr, "%s: at most %d --probe SSIDs\n", argv[0], WIFI_SCAN_MAX_SSIDS);
+				exit(1);
+			}
+			scan_ssids[scan_params.ssids_length++] = argv[++i];
+		}
 		else if (strncmp(argv[i], "--chan-descend", 13) == 0)
 			sort_key = 'c', ascending = false;
 		else if (strncmp(argv[i], "--chan", 6) == 0)
@@ -688,6 +952,18 @@ int main(int argc, char **argv)
 			sort_key = 'i', ascending = true;
 		else if (strncmp(argv[i], "--rf-progress", 4) == 0)
 			RF_scan_progress = true;
+		else if (strcmp(argv[i], "--cached") == 0)
+			cached_mode = true;
+		else if (strcmp(argv[i], "--max-age") == 0 && i + 1 < argc)
+			max_age_ms = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--vendors") == 0 && i + 1 < argc)
+			vendors_file = argv[++i];
+		else if (strcmp(argv[i], "--find-vendor") == 0 && i + 1 < argc)
+			find_vendor = argv[++i];
+		else if (strcmp(argv[i], "--vendors-local") == 0 && i + 1 < argc) {
+			if ((local_vendors = vendor_db_open(argv[++i])) == NULL)
+				exit(1);
+		}
 		else if (strncmp(argv[i], "--", 2) == 0) {
 			Usage(argv);
 			exit (1);
@@ -700,8 +976,18 @@ int main(int argc, char **argv)
 		exit(1);
 	}
 
-	if (vendor_initialise("mac-vendors-export.csv") < 0)
+	// the table built into the program needs no file and no work, --vendors FILE overrides it
+	if (!vendors_file) {
+		if (vendor_initialise_image(mac_vendors_db, mac_vendors_db_end - mac_vendors_db) < 0)
+			exit(1);
+	} else if (vendor_initialise(vendors_file) < 0)
 		exit(1);
+	// this thread resolves the vendors, while the table gets reloaded whenever the file changes
+	vendor_reader_register();
+	if (vendors_file)
+		vendor_watch(vendors_file);
+	vendors_generation = vendor_generation();
+	find_vendor_update();
 	initialise();
 	initscr();
 	cbreak();
@@ -762,20 +1048,33 @@ int main(int argc, char **argv)
 
 	// initialize the library with network interface argv[1] (e.g. wlan0)
 	wifi = wifi_scan_init(wifi_if);
-
-	pthread_mutex_lock(&first_scan_mutex);
-
-	if (pthread_create(&scan_threadID, NULL, &wifi_scan_thread, NULL) == -1) {
-		perror("pthread");
-		exit(1);
+	if (rolling_mode)
+		rolling = wifi_scan_rolling_init(wifi, &scan_params, rolling_group);
+	if (rolling)
+		wifi_scan_pacing_init(&pacing, PACING_ROLLING_MIN_MS, PACING_ROLLING_MAX_MS);
+	else
+		wifi_scan_pacing_init(&pacing, PACING_MIN_MS, PACING_MAX_MS);
+
+	// the flags the device can't do are left out by the library, tell which
+	if (scan_params.flags & ~wifi_scan_supported_flags(wifi)) {
+		wprintw(wintext, "\n\nNot supported by %s, scanning without:", wifi_if);
+		for (unsigned int i = 0; i < N_SCAN_FLAGS; i++)
+			if (scan_params.flags & scan_flag_names[i].flag & ~wifi_scan_supported_flags(wifi))
+				wprintw(wintext, " %s", scan_flag_names[i].name);
+		wprintw(wintext, "\n\nRF scanning .");
+		wrefresh(wintext);
 	}
 
-	while (!READ_ONCE(first_scan_passed)) {
-		// pthread_mutex_lock(&first_scan_mutex);
+	do {
+		//the device may be busy, then try again in a while
+		if (!cached_mode && !RF_scanning && now_ms() >= next_scan_ms && scan_start() == -1)
+			next_scan_ms = now_ms() + SCAN_RETRY_MS;
+		if (cached_mode && cache_collect())
+			break;
+		scan_deadline();
 		wprintw(wintext, ".");
 		wrefresh(wintext);
-		usleep(200000);
-	}
+	} while (!((wait_events(SCAN_RETRY_MS, EVENT_SCAN) & EVENT_SCAN) && scan_collect()));
 
 	wprintw(wintext, " done.\n\nPress any key ... ");
 	wrefresh(wintext);
@@ -789,6 +1088,18 @@ int main(int argc, char **argv)
 
 	while(1)
 	{
+		uint64_t now;
+		int timeout_ms, events;
+
+		// the vendor names from the last round are not used any more
+		vendor_quiescent();
+		if (vendor_generation() != vendors_generation) {
+			vendors_generation = vendor_generation();
+			find_vendor_update();
+			CLEAR_ONCE(sorted);
+			perform_sorting();
+			wscreen->repaint();
+		}
 
 		if (READ_ONCE(resized)) {
 			wscreen->resize();
@@ -796,7 +1107,36 @@ int main(int argc, char **argv)
 			CLEAR_ONCE(resized);
 		}
 
-		if (kbhit()) {
+		scan_deadline();
+
+		now = now_ms();
+		if (cached_mode && now >= next_scan_ms) {
+			if (cache_collect()) {
+				perform_sorting();
+				wscreen->repaint();
+			}
+		} else if (!RF_scanning && now >= next_scan_ms && scan_start() == -1) {
+			//it may happen that device is unreachable (e.g. the device works in such way that it doesn't respond while scanning)
+			//a busy device is waited for longer and longer, until it scans again
+			int error = errno;
+
+			if (error != EBUSY)
+				perror("Unable to get scan data");
+			scan_delay_ms = wifi_scan_pacing_failed(&pacing, error);
+			next_scan_ms = now + scan_delay_ms;
+		}
+
+		//wake up for the progress bar, for the vendor table reloads and for the next scan
+		if (RF_scanning && RF_scan_progress)
+			timeout_ms = 1000 / SCREEN_REFRESH_HZ;
+		else if (RF_scanning || next_scan_ms - now > SCAN_RETRY_MS)
+			timeout_ms = SCAN_RETRY_MS;
+		else
+			timeout_ms = next_scan_ms - now;
+
+		events = wait_events(timeout_ms, EVENT_KEY | EVENT_SCAN);
+
+		if (events & EVENT_KEY) {
 			process_keypress_event();
 			perform_sorting();
 			// wifiarea_update(winwifiarea);
@@ -804,39 +1144,23 @@ int main(int argc, char **argv)
 			// wgraph->repaint();
 		}
 
-		if (READ_ONCE(RF_scanning)) {
-			do {
-				if (RF_scan_progress) {
-					INCR_ONCE(scanner_dots);
-					wrfbar->repaint();
-				}
-				if (READ_ONCE(resized)) {
-					wscreen->resize();
-					wscreen->repaint();
-					CLEAR_ONCE(resized);
-				} else if (kbhit()) {
-					process_keypress_event();
-					perform_sorting();
-					// wifiarea_update(winwifiarea);
-					wscreen->repaint();
-				}
-				usleep(1000000UL/SCREEN_REFRESH_HZ);
-			} while (READ_ONCE(RF_scanning));
-			//it may happen that device is unreachable (e.g. the device works in such way that it doesn't respond while scanning)
-			//you may test for errno==EBUSY here and make a retry after a while, this is how my hardware works for example
-			if (status < 0)
-				perror("Unable to get scan data");
-			else {
-				perform_sorting();
-				// wifiarea_update(winwifiarea);
-				wscreen->repaint();
-			}
-		} else
-			usleep(200000);
+		if ((events & EVENT_SCAN) && scan_collect()) {
+			perform_sorting();
+			// wifiarea_update(winwifiarea);
+			wscreen->repaint();
+		}
 
+		if (RF_scanning && RF_scan_progress) {
+			scanner_dots = (now_ms() - scan_started_ms) * SCREEN_REFRESH_HZ / 1000 + 1;
+			wrfbar->repaint();
+		}
 	}
 	
 	//free the library resources
+	bss_list_free(&scan_list);
+	bss_list_free(&next_list);
+	if (rolling)
+		wifi_scan_rolling_close(rolling);
 	wifi_scan_close(wifi);
 
 	endwin();
@@ -847,8 +1171,11 @@ int main(int argc, char **argv)
 void Usage(char **argv)
 {
 	printf("Usage:\n");
-	printf("%s wireless_interface\n\n", argv[0]);
+	printf("%s [--cached [--max-age MS]] [--channels 1,6,11,...] [--dwell MS] [--probe SSID]... [--scan-flags low-priority,low-span,...] [--rolling [--group N]] [--vendors mac-vendors.db|mac-vendors-export.csv] [--vendors-local FILE] [--find-vendor NAME] wireless_interface\n\n", argv[0]);
 	printf("examples:\n");
 	printf("%s wlan0\n", argv[0]);
+	printf("%s --channels 1,6,11 --dwell 30 wlan0\n", argv[0]);
+	printf("%s --scan-flags low-priority,low-span wlan0\n", argv[0]);
+	printf("%s --rolling --group 3 wlan0\n", argv[0]);
 	
 }
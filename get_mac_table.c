@@ -6,48 +6,316 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <values.h>
 #include <string.h>
 #include <time.h>
 #include <ctype.h>
 #include <errno.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <poll.h>
+#include <sys/inotify.h>
 
-#define NO_BUCKETS (2 << 12)
+#include "get_mac_table.h"
+
+/* Entries refer to their strings by offset into the string pool rather than by
+   pointer, so the table can be written to disk and mmap()-ed back as it is.
+   Vendor names are interned: each distinct name is stored once, and entries
+   refer to it by its index in the names array. */
 
 struct mac_vendor {
-	const char *mac;
-	unsigned long long ulmac;
-	const char *vendor;
-} __aligned;
-
-struct mac_vendor_listitem {
-	struct mac_vendor_listitem *next;
-	struct mac_vendor_listitem *prev;
-	const char *mac;
-	const char *vendor;
+	uint64_t key;		/* HASH_KEY(prefix, bits): the prefix as a 48-bit MAC, bits past it zero */
+	uint32_t mac;		/* offset of the prefix text in the string pool */
+	uint32_t name;		/* index into the names */
+};
+
+struct vendor_name {
+	uint32_t off;		/* offset in the string pool */
+	uint32_t len;		/* strlen() of the name */
+};
+
+/*
+ * Longest prefix match trie
+ *
+ * Keyed on the MAC as a 48-bit integer, with one level per IEEE block size:
+ *
+ *   level 24: the OUIs, grouped by their top 16 bits (trie_dir[] holds the
+ *	       range of each group, trie_lo[] the low OUI byte of its members)
+ *   level 28: 16 nodes per OUI that has MA-M or MA-S blocks, one per nibble
+ *   level 36: 256 entries per level 28 node that has MA-S blocks
+ *
+ * A node's entry is the vendor of that prefix (index into the table + 1,
+ * 0 for none); child is the block number + 1 of the next level (0 for none).
+ * A lookup touches at most five cache lines and never compares strings.
+ */
+
+#define TRIE_DIR_SIZE	(1 << 16)
+#define TRIE_BATCH	16	/* keys in flight in get_vendors_by_macs() */
+#define TRIE_L28_FANOUT	16
+#define TRIE_L36_FANOUT	256
+
+struct trie_node {
+	uint32_t entry;
+	uint32_t child;
+};
+
+/*
+ * Flat vendor hash table
+ *
+ * One contiguous array of slots, open addressing with Robin Hood insertion,
+ * keyed on the prefix as an integer with its length in bits 48-55. An OUI
+ * slot also says whether MA-M or MA-S blocks live under it, so a lookup
+ * tries at most three keys, each within hash_max_psl + 1 adjacent slots.
+ */
+
+#define HASH_HAS_28	0x1
+#define HASH_HAS_36	0x2
+
+#define HASH_KEY(PREFIX, BITS) ((PREFIX) | (unsigned long long) (BITS) << 48)
+
+struct hash_slot {
+	uint64_t key;		/* HASH_KEY(), 0 for an empty slot */
+	uint32_t entry;		/* table index + 1, 0 for an OUI with only longer blocks */
+	uint16_t psl;		/* probe sequence length: distance from the home slot */
+	uint16_t flags;		/* HASH_HAS_28, HASH_HAS_36 */
 };
 
-struct mac_vendor_list {
-	struct mac_vendor_listitem *head, *tail;
-	unsigned int n;
+/*
+ * OUI presence bitmap
+ *
+ * One bit for each of the 2^24 OUIs, set if anything (MA-L, MA-M or MA-S) is
+ * assigned under it: 2 MiB that settle a lookup of an unassigned MAC in one
+ * access. Such a MAC is then "Randomized/LAA" if it is a locally administered
+ * unicast address and "Unassigned" otherwise. CIDs have the local bit set
+ * too, but they are in the bitmap and get looked up like any OUI.
+ */
+
+#define OUI_MAP_WORDS	((1 << 24) / 64)
+
+/*
+ * Reverse index
+ *
+ * From a name to its entries: the entries of names[i] are
+ * name_entries[name_first[i] .. name_first[i + 1]), in prefix order.
+ *
+ * For searching the names, every distinct trigram (3 characters, each folded
+ * onto one of 32 symbols, letters regardless of case) of every name has a
+ * list of the names containing it, in trigram_names[] from trigrams[t].first
+ * up to trigrams[t + 1].first; trigrams[] is sorted by key and ends with a
+ * sentinel. A search only has to check the names on the shortest list among
+ * the trigrams of the pattern.
+ */
+
+#define TRIGRAM_KEYS	(1 << 15)
+
+struct trigram {
+	uint32_t key;		/* 5 bits per symbol, the first one in bits 10-14 */
+	uint32_t first;		/* index into trigram_names */
 };
 
+#define MAC48_LOCAL_BIT	(0x02ULL << 40)
+#define MAC48_GROUP_BIT	(0x01ULL << 40)
+
 #define HW_MAC_STR_LEN 17
-#define MAX_VENDORS_INIT 24576
 
 #define EVENDORFORMAT  1024
+#define EVENDORIMAGE   1025
+
+/*
+ * Errors and statistics
+ *
+ * Nothing but errors gets printed, and not even those from the thread that
+ * reloads in the background, where they would land on the screen of the UI;
+ * vendor_reload_stats() keeps the last one instead. What a table is made of
+ * and how it was built is in vendor_db_stats(). Lookups are counted only
+ * while vendor_count_lookups() is on, so that they cost nothing otherwise.
+ */
+
+static __thread int vendor_quiet = 0;
+static __thread char vendor_errbuf[256];
+
+__attribute((format(printf, 1, 2)))
+static void vendor_error(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(vendor_errbuf, sizeof(vendor_errbuf), fmt, ap);
+	va_end(ap);
+	if (!vendor_quiet)
+		fprintf(stderr, "%s\n", vendor_errbuf);
+}
+
+static inline uint64_t vendor_clock_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static _Atomic int vendor_counting = 0;
+
+/*
+ * Precompiled vendor image
+ *
+ * The image is the sorted vendor table, its string pool and the lookup
+ * structures, dumped as they are in memory, so that vendor_initialise() can
+ * mmap() it and use it in place. Sections are 64-byte aligned; the checksum
+ * covers everything after the header. The image is in host byte order and is
+ * rejected elsewhere.
+ *
+ * Loading the CSV builds the very same layout in one anonymous mapping (the
+ * arena), so either way all of the table is in vendor_db.image, and it goes
+ * away with one munmap().
+ */
+
+#define VENDOR_IMAGE_MAGIC		"YAWAOUI"
+#define VENDOR_IMAGE_VERSION		8
+#define VENDOR_IMAGE_BYTE_ORDER		0x01020304
+#define VENDOR_IMAGE_MAX_SECTIONS	16
+#define VENDOR_IMAGE_ALIGN		64
+
+#define IMAGE_ALIGN(X) (((X) + VENDOR_IMAGE_ALIGN - 1) & ~(uint64_t)(VENDOR_IMAGE_ALIGN - 1))
+
+enum vendor_image_section_id {
+	VIS_ENTRIES = 1,
+	VIS_STRINGS = 2,
+	VIS_TRIE_DIR = 3,
+	VIS_TRIE_LO = 4,
+	VIS_TRIE_L24 = 5,
+	VIS_TRIE_L28 = 6,
+	VIS_TRIE_L36 = 7,
+	VIS_HASH = 8,
+	VIS_NAMES = 9,
+	VIS_OUI_MAP = 10,
+	VIS_NAME_FIRST = 11,
+	VIS_NAME_ENTRIES = 12,
+	VIS_TRIGRAMS = 13,
+	VIS_TRIGRAM_NAMES = 14,
+};
+
+struct vendor_image_section {
+	uint32_t id;
+	uint32_t count;		/* number of elements */
+	uint64_t offset;	/* from the start of the image */
+	uint64_t size;		/* in bytes */
+};
+
+struct vendor_arena {
+	char *base;
+	size_t size, used;
+};
+
+struct vendor_image_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	uint64_t image_size;
+	uint64_t checksum;	/* FNV-1a over bytes [sizeof(header), image_size) */
+	uint32_t n_sections;
+	uint32_t hash_keys;	/* so that a trusted image needs no pass over the hash */
+	uint32_t hash_max_psl;
+	uint32_t reserved;
+	struct vendor_image_section section[VENDOR_IMAGE_MAX_SECTIONS];
+};
 
 #define SWAPXY(X,Y) ({ __typeof(X) tmp = (X); (X) = (Y); (Y) = tmp; })
 
 #define ROTL32(X,D) ((X) << (D) | (X) >> (32 - (D)) & 0xffffffff)
 
-size_t max_vendors = 0;
-size_t n_vendors = 0;
-size_t vend_increment = 1024;
+/*
+ * Hot reload
+ *
+ * Everything one table consists of is in a struct vendor_db, and the lookups
+ * use whichever one vendor_current points to at the time. A new table is built
+ * on the side, published with one atomic pointer swap, and the old one is
+ * unmapped only once every registered reader has passed a quiescent state
+ * (QSBR), so a lookup never waits and never sees a half built table.
+ */
+
+struct vendor_db {
+	/* the mapped image or the arena holding all of the below */
+	void *image;
+	size_t image_size;
+	int image_borrowed;	/* not ours to unmap, see vendor_db_open_image() */
+	uint64_t generation;	/* 1 for the first table published, then counts reloads */
+
+	struct mac_vendor *table;
+	size_t n_vendors, max_vendors;
+	struct vendor_name *names;
+	uint32_t n_names;
+	char *strings;
+	size_t strings_size, max_strings;
+
+	struct hash_slot *hash;
+	uint64_t *oui_map;
+	uint32_t hash_mask, n_hash_keys, hash_max_psl;
+
+	uint32_t *trie_dir;
+	uint8_t *trie_lo;
+	struct trie_node *trie_l24, *trie_l28;
+	uint32_t *trie_l36;
+	uint32_t n_trie_l24, n_trie_l28, n_trie_l36;	/* nodes, blocks, blocks */
+
+	uint32_t *name_first, *name_entries;
+	struct trigram *trigrams;
+	uint32_t *trigram_names;
+	uint32_t n_trigrams;	/* without the sentinel */
+
+	uint64_t build_ns[VENDOR_PHASES];
+
+	/* the one part that changes after publishing, see vendor_count_lookups() */
+	struct {
+		_Atomic uint64_t lookups, hits;
+	} __attribute((aligned(64))) counters;
+
+	/* names seen so far while loading the CSV: names index + 1, 0 for empty */
+	uint32_t *name_intern;
+	size_t name_intern_mask;
+	struct vendor_arena *name_intern_arena;
+};
+
+#define NAME_INTERN_INIT 4096
+
+static struct vendor_db *_Atomic vendor_current = NULL;
+
+/* serialises the writers: publishing, reclaiming and vendor_write_image() */
+static pthread_mutex_t vendor_update_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t vendor_generation_count = 0;
+static _Atomic uint64_t vendor_published = 0;	/* generation of vendor_current */
+
+/* what vendor_reload_stats() reports; not under vendor_update_lock, which
+   a writer holds while it waits for the readers */
+static pthread_mutex_t vendor_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t vendor_reloads = 0, vendor_reload_failures = 0;
+static char vendor_reload_error[256] = "";
+
+#define VT_MAC(DB, I)        ((DB)->strings + (DB)->table[I].mac)
+#define VT_VENDOR(DB, I)     ((DB)->strings + (DB)->names[(DB)->table[I].name].off)
+#define VT_VENDOR_LEN(DB, I) ((DB)->names[(DB)->table[I].name].len)
+#define VT_PREFIX(DB, I)     ((DB)->table[I].key & 0xffffffffffffULL)
+#define VT_BITS(DB, I)       ((uint32_t) ((DB)->table[I].key >> 48))
+
+/* The table the lookups without a handle run on; NULL before vendor_initialise(). */
+
+const struct vendor_db *vendor_db_current(void)
+{
+	return atomic_load_explicit(&vendor_current, memory_order_acquire);
+}
 
-static struct mac_vendor *vendorTable = NULL;
-struct mac_vendor_list *hash_bucket = NULL;
+static const char vendor_unassigned[] = "Unassigned";
+static const char vendor_local[] = "Randomized/LAA";
+
+const char *get_vendor_by_mac_binary (const char *mac);
+const char *get_vendor_by_mac_trie (const char *mac);
 
 static inline int strmatchlen(const char *s1, const char *s2)
 {
@@ -63,367 +331,598 @@ static inline int strmatchlen(const char *s1, const char *s2)
 	return n;
 }
 
-__attribute((pure))
-static inline char * strtoupper (const char *s1)
+
+
+/*
+ * MACs in any notation
+ *
+ * hex_table[] is each hex digit's value plus one, zero for any other byte,
+ * so a MAC decodes in twelve table loads with no branch per digit and no
+ * case folding: a bad digit turns into UINT_MAX and shows up in the OR of
+ * them all. Every lookup that starts from text and the CSV loader go
+ * through here.
+ */
+
+static const uint8_t hex_table[256] = {
+	['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5,
+	['5'] = 6, ['6'] = 7, ['7'] = 8, ['8'] = 9, ['9'] = 10,
+	['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+	['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16,
+};
+
+/* where the digits are: aa:bb:cc:dd:ee:ff or aa-bb-..., aabb.ccdd.eeff, aabbccddeeff */
+static const uint8_t mac_digits_sep[12]  = { 0, 1, 3, 4, 6, 7, 9, 10, 12, 13, 15, 16 };
+static const uint8_t mac_digits_dot[12]  = { 0, 1, 2, 3, 5, 6, 7, 8, 10, 11, 12, 13 };
+static const uint8_t mac_digits_bare[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+
+static inline int mac_decode(const char *s, const uint8_t at[12], uint8_t mac[6])
 {
-	char *rets = strdup(s1);
-	char *p = rets;
+	unsigned int bad = 0;
+
+	for (int i = 0; i < 6; i++) {
+		unsigned int hi = hex_table[(unsigned char) s[at[2 * i]]] - 1;
+		unsigned int lo = hex_table[(unsigned char) s[at[2 * i + 1]]] - 1;
 
-	if (rets)
-		while ((*(p++) = toupper(*(s1++))));
+		bad |= hi | lo;
+		mac[i] = hi << 4 | lo;
+	}
 
-	return rets;
-			
+	return !(bad & ~0xfU);
 }
 
-__attribute((pure))
-static inline unsigned int nindex(const char *p, char c)
+/* n characters were a MAC if it does not run on into more digits or groups. */
+
+static inline size_t mac_end(const char *s, size_t len, size_t n, char sep)
 {
-	return index(p, c) - p;
+	if (n < len && (hex_table[(unsigned char) s[n]] || s[n] == sep))
+		return 0;
+	return n;
 }
 
-unsigned long long time_nanoseconds()
+size_t mac_parse(const char *s, size_t len, uint8_t mac[6])
 {
-	struct timespec ts;
+	if (len >= 17 && (s[2] == ':' || s[2] == '-')) {
+		char sep = s[2];
+
+		if (s[5] != sep || s[8] != sep || s[11] != sep || s[14] != sep ||
+		    !mac_decode(s, mac_digits_sep, mac))
+			return 0;
+		return mac_end(s, len, 17, sep);
+	}
 
-	if (clock_gettime(CLOCK_REALTIME, &ts) == -1) {
-		perror("clock_gettime");
-		exit(1);
+	if (len >= 14 && s[4] == '.') {
+		if (s[9] != '.' || !mac_decode(s, mac_digits_dot, mac))
+			return 0;
+		return mac_end(s, len, 14, '.');
 	}
 
-	return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+	if (len >= 12 && mac_decode(s, mac_digits_bare, mac))
+		return mac_end(s, len, 12, 0);
+
+	return 0;
 }
 
-__attribute((pure))
-unsigned int mac_crc12(const char *mac) {
-	// unsigned int crc = 0;
-	const char *hexdigits = "0123456789ABCDEF";
-/*
-	for (char *p = mac; *p && p - mac < HW_MAC_STR_LEN; ) {
-		crc ^= ROTL32(crc, 2) ^ index("0123456789ABCDEF", *p++) << 4 + index("0123456789ABCDEF", *p++);
-		if (*p == ':')
-			p++;
+const char *mac_find(const char *s, size_t len, uint8_t mac[6], size_t *mac_len)
+{
+	/* every notation starts with two digits and then a third or a separator,
+	   which rules out most words before mac_parse() has to look */
+	for (size_t i = 0; i + 12 <= len; i++) {
+		size_t n;
+		char sep;
+
+		if (!hex_table[(unsigned char) s[i]] || !hex_table[(unsigned char) s[i + 1]] ||
+		    !(hex_table[(unsigned char) s[i + 2]] || s[i + 2] == ':' || s[i + 2] == '-'))
+			continue;
+		if (i > 0 && (hex_table[(unsigned char) s[i - 1]] || s[i - 1] == ':'))
+			continue;	/* inside a longer number or an IPv6 address */
+		/* nor may it be the tail of a run with too many groups, which
+		   would give a MAC shifted by one group */
+		sep = s[i + 2] == ':' || s[i + 2] == '-' ? s[i + 2] : s[i + 4] == '.' ? '.' : 0;
+		if (i > 0 && sep && s[i - 1] == sep)
+			continue;
+		if ((n = mac_parse(s + i, len - i, mac)) > 0) {
+			if (mac_len)
+				*mac_len = n;
+			return s + i;
+		}
 	}
 
-	return (crc >> 16 ^ crc) & 0xffff;
-*/
-	return (nindex (hexdigits, mac[0]) << 8 | nindex (hexdigits, mac[3]) << 4 | nindex (hexdigits, mac[6])) ^
-	       (nindex (hexdigits, mac[4]) << 8 | nindex (hexdigits, mac[1]) << 4 | nindex (hexdigits, mac[7]));
+	return NULL;
 }
 
-__attribute((pure))
-unsigned long long ulmac(const char *mac)
+/* Parse a (partial) MAC in either case into the top bits of a 48-bit integer,
+   reading at most len characters or up to a NUL: a whole MAC in any notation
+   mac_parse() knows, or its first digits in groups of two, all separated by
+   either ':' or '-'. The last group may be a single digit, as in the CSV's
+   "70:B3:D5:12:3". Returns the number of bits parsed, or -1 on garbage. */
+
+static int mac_prefix_parse_n(const char *mac, size_t len, unsigned long long *prefix)
 {
-	const char *hexdigits = "0123456789ABCDEF";
+	unsigned long long v = 0;
+	unsigned int bad = 0;
+	size_t n = strnlen(mac, len);
+	int ndigits = 0;
+	uint8_t b[6];
+	char sep;
+
+	if (n >= 12 && mac_parse(mac, n, b) == n) {
+		for (int i = 0; i < 6; i++)
+			v = v << 8 | b[i];
+		*prefix = v;
+		return 48;
+	}
+
+	if (n == 0 || n > HW_MAC_STR_LEN)
+		return -1;
+	sep = n > 2 ? mac[2] : ':';
+	bad = (sep != ':' && sep != '-') << 4;
+
+	for (size_t i = 0; i < n; i += 3) {
+		unsigned int hi = hex_table[(unsigned char) mac[i]] - 1, lo;
+
+		if (n - i == 1) {
+			bad |= hi;
+			v = v << 4 | hi;
+			ndigits++;
+			break;
+		}
+
+		lo = hex_table[(unsigned char) mac[i + 1]] - 1;
+		bad |= hi | lo;
+		v = v << 8 | hi << 4 | lo;
+		ndigits += 2;
+		if (i + 2 < n)
+			bad |= (mac[i + 2] != sep) << 4;
+	}
 
-	return
-		nindex(hexdigits, mac[0]) << 20 |
-		nindex(hexdigits, mac[1]) << 16 |
-		nindex(hexdigits, mac[3]) << 12 |
-		nindex(hexdigits, mac[4]) <<  8 |
-		nindex(hexdigits, mac[6]) <<  4 |
-		nindex(hexdigits, mac[7]);
+	if (bad & ~0xfU)
+		return -1;
 
+	*prefix = v << (48 - 4 * ndigits);
+	return 4 * ndigits;
 }
 
-__attribute((pure))
-int mid_sq(const char *mac)
+static inline int mac_prefix_parse(const char *mac, unsigned long long *prefix)
 {
-	unsigned crc12 = mac_crc12(mac);
-	unsigned long sq = crc12 * crc12;
-
-	return (sq >> 6) & 0x00000fff;
+	return mac_prefix_parse_n(mac, SIZE_MAX, prefix);
 }
 
-void print_list (struct mac_vendor_list *bucket_slot)
+/* The string engines compare against the CSV's text, which is upper case
+   with colons: mac is parsed and written out that way into buf, so they
+   take any notation without allocating. Returns NULL on garbage. */
+
+static char *mac_canonical(const char *mac, char buf[HW_MAC_STR_LEN + 1])
 {
-	struct mac_vendor_listitem *p;
+	static const char hex[] = "0123456789ABCDEF";
+	unsigned long long v;
+	char *q = buf;
+	int bits;
+
+	if ((bits = mac_prefix_parse(mac, &v)) < 0)
+		return NULL;
 
-	printf("<list>\n");
-	for (p = bucket_slot->head; p; p = p->next) {
-		printf("%s\n", p->mac);
+	for (int shift = 44; shift >= 48 - bits; shift -= 4) {
+		*q++ = hex[v >> shift & 0xf];
+		if (shift % 8 == 0 && shift > 48 - bits)
+			*q++ = ':';
 	}
-	printf("</list>\n");
+	*q = '\0';
+
+	return buf;
+}
+
+/* The CSV's "Block Type" column, p pointing at its first of len remaining
+   characters on the line. CID and private entries are OUI sized, IAB is the
+   older name for the 36-bit block. */
+
+static int block_type_bits(const char *p, size_t len)
+{
+	const char *comma = (const char *) memchr(p, ',', len);
+
+	if (comma)
+		len = comma - p;
+	if ((len == 4 && memcmp(p, "MA-L", 4) == 0) || (len == 3 && memcmp(p, "CID", 3) == 0))
+		return 24;
+	if (len == 4 && memcmp(p, "MA-M", 4) == 0)
+		return 28;
+	if ((len == 4 && memcmp(p, "MA-S", 4) == 0) || (len == 3 && memcmp(p, "IAB", 3) == 0))
+		return 36;
+	return 0;
 }
 
-void list_add_item (struct mac_vendor_list *const bucket_slot, unsigned index, const struct mac_vendor *mv)
+__attribute((pure))
+static inline int oui_assigned(const struct vendor_db *db, unsigned long long mac48)
 {
-	struct mac_vendor_listitem *p, *q, *pitem = (struct mac_vendor_listitem *) malloc (sizeof (struct mac_vendor_listitem));
-	// int newlen = strlen(mv->mac);
-	// printf("slot %06x: %d items: newlen=%d '%s' -> '%s'.\n", index, bucket_slot->n, newlen, mv->mac, mv->vendor);
+	uint32_t oui = mac48 >> 24;
 
-	if (!pitem)
-		printf("slot %06x: %d items: not allocated: '%s' -> '%s'.\n", index, bucket_slot->n, mv->mac, mv->vendor);
+	return db->oui_map[oui >> 6] >> (oui & 63) & 1;
+}
 
-	pitem->mac    = mv->mac;
-	pitem->vendor = mv->vendor;
+/* What to say about a MAC that matches no assignment. */
 
-	// printf("slot %06x: %d items: newlen=%d '%s' -> '%s'.\n", index, bucket_slot->n, newlen, mv->mac, mv->vendor);
-	// print_list(bucket_slot);
-	if (bucket_slot->head == NULL) {
-		/* the empty hash slot */
-		// printf("slot %06x: adding to empty head '%s' -> '%s'.\n", index, mv->mac, mv->vendor);
-		pitem->next       = NULL;
-		pitem->prev       = NULL;
-		bucket_slot->head = pitem;
-	} else {
-		/* bucket_slot->head should be non-NULL ?! */
-		// printf("bucket_slot->head=%0p\n", bucket_slot->head);
-		// printf("bucket_slot->head->mac=%0p\n", bucket_slot->head->mac);
-		// printf("strlen(bucket_slot->head->mac)=%d\n", strlen(bucket_slot->head->mac));
-		// printf("slot %06x: checkpoint: if strlen=%d '%s': '%s' -> '%s'.\n", index, strlen(bucket_slot->head->mac), bucket_slot->head->mac, mv->mac, mv->vendor);
-		// if (strlen(bucket_slot->head->mac) < newlen) {
-		if (strcmp(bucket_slot->head->mac, mv->mac) > 0) {
-			/* this new item should come first */
-			// printf("slot %06x: adding before first.len=%d '%s' -> '%s'.\n", index, strlen(bucket_slot->head->mac), mv->mac, mv->vendor);
-			pitem->next       = bucket_slot->head;
-			pitem->prev       = NULL;
-			bucket_slot->head->prev = pitem;
-			bucket_slot->head = pitem;
-		} else {
-			// printf("slot %06x: checkpoint: start walk: '%s' -> '%s'.\n", index, mv->mac, mv->vendor);
-			for (q = p = bucket_slot->head; p && strcmp(p->mac, mv->mac) < 0; q = p, p = p->next);
-			// printf("slot %06x: before choice p mac '%s': '%s' -> '%s'.\n", index, p ? p->mac : "nulll", mv->mac, mv->vendor);
-			if (p) { /* found the place to insert new item */
-				// printf("slot %06x: inserting before p mac '%s': '%s' -> '%s'.\n", index, p->mac, mv->mac, mv->vendor);
-				if (p->prev)
-					p->prev->next = pitem;
-				pitem->next = p;
-				pitem->prev = p->prev;
-				p->prev = pitem;
-			} else { /* last item */
-				// printf("slot %06x: inserting after mac '%s': '%s' -> '%s'.\n", index, q->mac, mv->mac, mv->vendor);
-				q->next = pitem;
-				pitem->prev = q;
-				pitem->next = NULL;
-			}
-		}
+static inline const char *mac_unassigned(unsigned long long mac48, size_t *len)
+{
+	if ((mac48 & (MAC48_LOCAL_BIT | MAC48_GROUP_BIT)) == MAC48_LOCAL_BIT) {
+		if (len)
+			*len = sizeof(vendor_local) - 1;
+		return vendor_local;
 	}
-	// print_list(bucket_slot);
-	// printf("slot %06x: %d items: end: '%s' -> '%s'.\n", bucket_slot->n, index, mv->mac, mv->vendor);
 
-	++ (bucket_slot->n);
+	if (len)
+		*len = sizeof(vendor_unassigned) - 1;
+	return vendor_unassigned;
 }
 
-const char *list_get_item (struct mac_vendor_list *bucket_slot, const char *mac)
+/* The OUI of a MAC, 0 if it has none. */
+
+__attribute((pure))
+unsigned long long ulmac(const char *mac)
 {
-	struct mac_vendor_listitem *p, *pbest = NULL;
-	int best_len = 0, new_len;
+	unsigned long long mac48;
+
+	if (mac_prefix_parse(mac, &mac48) < 24)
+		return 0;
+	return mac48 >> 24;
+}
 
-	if (!bucket_slot->head)
-		return "Unknown-1";
+/* The arena is anonymous memory, so it comes zeroed and pages that are never
+   written cost no RSS; the scratch arena of the CSV loader relies on that. */
 
-	/* find the first match */
+static int arena_map(struct vendor_arena *a, size_t size)
+{
+	void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
 
-	for (p = bucket_slot->head; p; p = p->next) {
-		// fprintf(stderr, "list_get_item: mac=%s p->mac=%p p->mac=%s p>vendor=%s\n", mac, p->mac, p->mac, p->vendor);
-		// if (strncmp(p->mac, mac, strmatchlen(p->mac, mac) >= 8) == 0) {
-		if (strncmp(p->mac, mac, 8) == 0) {
-			// fprintf(stderr, "list_get_item: MATCH mac=%s p->mac==%s p->mac=%s p->vendor=%s\n", mac, p->mac, p->mac, p->vendor);
-			pbest = p;
-			best_len = strlen(p->mac);
-			break;
-		}
+	if (base == MAP_FAILED) {
+		vendor_error("mmap: %s", strerror(errno));
+		return -ENOMEM;
 	}
 
-	if (!pbest)
-		return "Unknown";
+	a->base = (char *) base;
+	a->size = size;
+	a->used = 0;
+	return 0;
+}
 
-	/* Adjust for longer length vendor prefixes */
-	for (p = pbest; p; p = p->next) {
-		// fprintf(stderr, "list_get_item: mac=%s p->mac=%p p->mac=%s p>vendor=%s\n", mac, p->mac, p->mac, p->vendor);
-		if ((new_len = strmatchlen(p->mac, mac)) > best_len /* && strncmp(p->mac, mac, new_len) == 0 */) {
-			// fprintf(stderr, "list_get_item: BETTER mac=%s p->mac=%s p->mac=%p p->vendor=%s\n", mac, p->mac, p->mac, p->vendor);
-			pbest = p;
-			best_len = new_len;
-		} else if (new_len < best_len)
-			break;
-	}
+static void arena_unmap(struct vendor_arena *a)
+{
+	if (a->base)
+		munmap(a->base, a->size);
+	a->base = NULL;
+	a->size = a->used = 0;
+}
+
+static void *arena_alloc(struct vendor_arena *a, size_t size)
+{
+	void *p;
 
-	// fprintf(stderr, "list_get_item: BEST mac=%s p->mac=%p p->mac=%s p->vendor=%s\n", mac, pbest->mac, pbest->mac, pbest->vendor);
-	return pbest->vendor;
+	if (IMAGE_ALIGN(size) > a->size - a->used)
+		return NULL;
+	p = a->base + a->used;
+	a->used += IMAGE_ALIGN(size);
+	return p;
 }
 
-const char *get_vendor_by_mac_hashtable (const char *mac_parm)
+/* Allocates a section of the image being built in a, which starts with its
+   vendor_image_header. */
+
+static void *arena_section(struct vendor_arena *a, uint32_t id, size_t elem_size, uint32_t count)
 {
-	// struct mac_vendor_listitem *p;
-	char *mac = strtoupper(mac_parm);
-	const char *rets;
+	struct vendor_image_header *hdr = (struct vendor_image_header *) a->base;
+	uint64_t off = a->used, size = (uint64_t) count * elem_size;
+	void *p;
 
-	if (!mac)
+	if (hdr->n_sections == VENDOR_IMAGE_MAX_SECTIONS || (p = arena_alloc(a, size)) == NULL)
 		return NULL;
 
-	rets = list_get_item(&hash_bucket[mac_crc12(mac)], mac);
-	// rets = list_get_item(&hash_bucket[1], mac);
-	free(mac);
+	hdr->section[hdr->n_sections++] = (struct vendor_image_section) { id, count, off, size };
+	hdr->image_size = a->used;
+	return p;
+}
+
+/* The MurmurHash3 64-bit finaliser: every key bit affects every index bit,
+   which the prefixes, all zero at the bottom, very much need. */
+
+__attribute((pure))
+static inline uint32_t hash_index(uint64_t key, uint32_t mask)
+{
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ULL;
+	key ^= key >> 33;
 
-	return rets;
+	return key & mask;
 }
-	
-void hash_populate(struct mac_vendor_list *hash_bucket, const struct mac_vendor *vendorTable)
+
+/* Adds key, or merges entry and flags into it if it is already there. A slot
+   poorer than its occupant (further from home) takes the occupant's place, and
+   the occupant moves on; this keeps every probe sequence short. */
+
+static void hash_insert(struct vendor_db *db, uint64_t key, uint32_t entry, uint16_t flags)
 {
-	printf("entering hash_populate()\n");
-	for (int i = 0; i < n_vendors; i++) {
-		// printf("adding item mac='%s' vendor='%s'\n", vendorTable[i].mac, vendorTable[i].vendor);
-		list_add_item(&hash_bucket[mac_crc12(vendorTable[i].mac)], mac_crc12(vendorTable[i].mac), &vendorTable[i]);
-		// list_add_item(&hash_bucket[1], 1, &vendorTable[i]);
+	struct hash_slot cur = { key, entry, 0, flags };
+	uint32_t i = hash_index(key, db->hash_mask);
+
+	for (;; i = (i + 1) & db->hash_mask, cur.psl++) {
+		struct hash_slot *s = &db->hash[i];
+
+		if (s->key == 0) {
+			*s = cur;
+			db->n_hash_keys++;
+			break;
+		}
+		if (s->key == cur.key) {
+			if (cur.entry)
+				s->entry = cur.entry;
+			s->flags |= cur.flags;
+			return;
+		}
+		if (s->psl < cur.psl) {
+			SWAPXY(*s, cur);
+			if (s->psl > db->hash_max_psl)
+				db->hash_max_psl = s->psl;
+		}
 	}
-	printf("leaving hash_populate()\n");
+
+	if (cur.psl > db->hash_max_psl)
+		db->hash_max_psl = cur.psl;
 }
-		// list_add_item(&hash_bucket[mac_crc12(vendorTable[i].mac)], mac_crc12(vendorTable[i].mac), &vendorTable[i]);
 
-int vendor_entry_compare (const void *e1, const void *e2)
+/* The table is at most half full: every entry has a key and every subdivided
+   OUI (n_l28 of them) may need one more. */
+
+__attribute((const))
+static uint32_t hash_slots(size_t n_entries, uint32_t n_l28)
 {
-	printf( "Comparing '%s' and '%s'.\n", ((struct mac_vendor *)e1)->mac, ((struct mac_vendor *)e2)->mac);
-	return strcmp(((struct mac_vendor *)e1)->mac, ((struct mac_vendor *)e2)->mac);
+	uint32_t n_slots = 1024;
+
+	while (n_slots < 2 * (n_entries + n_l28))
+		n_slots *= 2;
+
+	return n_slots;
 }
 
-static inline int partition(struct mac_vendor * const table, const int low, const int high)
+/* One pass over the table, after trie_build(). */
+
+static int hash_build(struct vendor_db *db, struct vendor_arena *a)
 {
-	int pivot = high;
-	int i = low - 1;
+	uint32_t n_slots = hash_slots(db->n_vendors, db->n_trie_l28);
 
-	for (int j = low; j <= high - 1; j++) {
-		if (strcmp(table[j].mac, table[pivot].mac) < 0) {
-			i++;
-			SWAPXY(table[i], table[j]);
-		}
+	db->hash = (struct hash_slot *) arena_section(a, VIS_HASH, sizeof(struct hash_slot), n_slots);
+	if (!db->hash)
+		return -ENOMEM;
+	db->hash_mask = n_slots - 1;
+	db->n_hash_keys = db->hash_max_psl = 0;
+
+	for (size_t i = 0; i < db->n_vendors; i++) {
+		unsigned long long p = VT_PREFIX(db, i);
+		uint32_t bits = VT_BITS(db, i);
+
+		if (bits > 24)
+			hash_insert(db, HASH_KEY(p & 0xffffff000000ULL, 24), 0, bits == 28 ? HASH_HAS_28 : HASH_HAS_36);
+		hash_insert(db, db->table[i].key, i + 1, 0);
 	}
-	SWAPXY(table[i + 1], table[high]);
-	return i + 1;
+
+	return 0;
 }
 
-void quickSort(struct mac_vendor *const table, const int low, const int high)
+__attribute((pure))
+static inline const struct hash_slot *hash_find(const struct vendor_db *db, uint64_t key)
 {
-	if (low < high) {
-		int pi = partition(table, low, high);
+	uint32_t i = hash_index(key, db->hash_mask);
 
-		quickSort(table, low, pi - 1);
-		quickSort(table, pi + 1, high);
+	for (uint32_t psl = 0; psl <= db->hash_max_psl; psl++, i = (i + 1) & db->hash_mask) {
+		const struct hash_slot *s = &db->hash[i];
+
+		if (s->key == key)
+			return s;
+		if (s->key == 0 || s->psl < psl)
+			break;
 	}
+
+	return NULL;
+}
+
+/* Returns the table index + 1 of the longest prefix of the first bits of
+   mac48, or 0, like trie_lookup(). */
+
+__attribute((pure))
+static inline uint32_t hash_lookup(const struct vendor_db *db, unsigned long long mac48, int bits)
+{
+	const struct hash_slot *oui, *s;
+
+	if ((oui = hash_find(db, HASH_KEY(mac48 & 0xffffff000000ULL, 24))) == NULL)
+		return 0;
+	if (bits >= 36 && (oui->flags & HASH_HAS_36) &&
+	    (s = hash_find(db, HASH_KEY(mac48 & 0xfffffffff000ULL, 36))))
+		return s->entry;
+	if (bits >= 28 && (oui->flags & HASH_HAS_28) &&
+	    (s = hash_find(db, HASH_KEY(mac48 & 0xfffffff00000ULL, 28))))
+		return s->entry;
+
+	return oui->entry;
 }
 
-static inline int partition_ulmac(struct mac_vendor *table, int low, int high)
+const char *get_vendor_by_mac_hashtable (const char *mac_parm)
 {
-	int pivot = high;
-	int i = low - 1;
+	const struct vendor_db *db = vendor_db_current();
+	unsigned long long mac48;
+	int bits;
+	uint32_t e;
 
-	for (int j = low; j <= high - 1; j++) {
-		if (table[j].ulmac < table[pivot].ulmac) {
-			i++;
-			SWAPXY(table[i], table[j]);
-		}
-	}
-	SWAPXY(table[i + 1], table[high]);
-	return i + 1;
+	if (db == NULL || (bits = mac_prefix_parse(mac_parm, &mac48)) < 24)
+		return "Unknown";
+
+	if (!oui_assigned(db, mac48) || (e = hash_lookup(db, mac48, bits)) == 0)
+		return mac_unassigned(mac48, NULL);
+
+	return VT_VENDOR(db, e - 1);
+}
+
+/*
+ * Sorting the vendor table
+ *
+ * The table is ordered by prefix, shorter blocks first, which for upper case
+ * text is also the strcmp() order the string searches rely on. The sort is an
+ * LSD radix sort on the integer key: O(n) for any input, stable (duplicates
+ * stay in file order), no recursion and no comparisons. Digits that are the
+ * same in every key, such as the low prefix bytes no block reaches, cost no
+ * pass, and input that is already sorted costs a single read.
+ */
+
+#define RADIX_DIGITS	7	/* vendor_sort_key() is 56 bits */
+
+__attribute((const))
+static inline uint64_t vendor_sort_key(uint64_t key)
+{
+	return (key & 0xffffffffffffULL) << 8 | key >> 48;
 }
 
-void quickSort_ulmac(struct mac_vendor *table, int low, int high)
+/* Sorts n elements of size bytes, each starting with a HASH_KEY(), using tmp
+   as room for another n. */
+
+static inline void radix_sort(void *base, size_t n, size_t size, void *tmp)
 {
-	if (low < high) {
-		int pi = partition_ulmac(table, low, high);
+	size_t count[RADIX_DIGITS][256];
+	char *src = (char *) base, *dst = (char *) tmp;
+	uint64_t key, last = 0;
+	int sorted = 1;
+
+	memset(count, 0, sizeof(count));
+
+	for (size_t i = 0; i < n; i++) {
+		key = vendor_sort_key(*(const uint64_t *) (src + i * size));
+		if (key < last)
+			sorted = 0;
+		last = key;
+		for (int d = 0; d < RADIX_DIGITS; d++)
+			count[d][key >> 8 * d & 0xff]++;
+	}
+
+	if (sorted || n < 2)
+		return;
+
+	for (int d = 0; d < RADIX_DIGITS; d++) {
+		size_t pos = 0;
+
+		key = vendor_sort_key(*(const uint64_t *) src);
+		if (count[d][key >> 8 * d & 0xff] == n)
+			continue;
+
+		for (int b = 0; b < 256; b++) {
+			size_t c = count[d][b];
 
-		quickSort_ulmac(table, low, pi - 1);
-		quickSort_ulmac(table, pi + 1, high);
+			count[d][b] = pos;
+			pos += c;
+		}
+
+		for (size_t i = 0; i < n; i++) {
+			key = vendor_sort_key(*(const uint64_t *) (src + i * size));
+			memcpy(dst + count[d][key >> 8 * d & 0xff]++ * size, src + i * size, size);
+		}
+
+		SWAPXY(src, dst);
 	}
+
+	if (src != base)
+		memcpy(base, src, n * size);
 }
 
 const char *get_vendor_by_mac (const char *mac_parm)
 {
+	const struct vendor_db *db = vendor_db_current();
 	int best_match = -1;
 	int best_match_len;
 	int current, match_len = 0;
-	char *mac = strtoupper(mac_parm);
-
-	if (!mac)
-		return NULL;
+	char buf[HW_MAC_STR_LEN + 1];
+	const char *mac = mac_canonical(mac_parm, buf);
 
-	if (vendorTable == NULL) {
-		fprintf(stderr, "Must call vendor_initialise() first!\n");
-		exit(1);
-	}
+	if (db == NULL || mac == NULL)
+		return "Unknown";
 
-	for (int i = 0; i < n_vendors; i++) {
-		// printf("%d of %d\r", i, n_vendors);
+	for (int i = 0; i < db->n_vendors; i++) {
+		// printf("%d of %d\r", i, db->n_vendors);
 		// fflush(stdout);
-		if (strncmp(vendorTable[i].mac, mac, strnlen(vendorTable[i].mac, HW_MAC_STR_LEN)) == 0) {
+		if (strncmp(VT_MAC(db, i), mac, strnlen(VT_MAC(db, i), HW_MAC_STR_LEN)) == 0) {
 			best_match = i;
 			break;
 		}
 	}
 
-	// printf("1: mac = '%p' best match = %d vendor='%p'\n", mac, best_match, vendorTable[best_match].vendor);
+	// printf("1: mac = '%p' best match = %d vendor='%p'\n", mac, best_match, VT_VENDOR(db, best_match));
 	// printf("1: mac = '%s' best match = %d\n", mac, best_match);
 
-	if (best_match == -1) {
-		free(mac);
+	if (best_match == -1)
 		return "Unknown";
-	} else if (best_match != n_vendors - 1) {
-		// printf("1: mac = '%s' best match = %d vendor='%s'\n", mac, best_match, vendorTable[best_match].vendor);
+	else if (best_match != db->n_vendors - 1) {
+		// printf("1: mac = '%s' best match = %d vendor='%s'\n", mac, best_match, VT_VENDOR(db, best_match));
 
-		// printf("1: mac = '%s' best match = %d vendor='%s'\n", mac, best_match, vendorTable[best_match].vendor);
+		// printf("1: mac = '%s' best match = %d vendor='%s'\n", mac, best_match, VT_VENDOR(db, best_match));
 		current = best_match;
 		// printf("entering strmatchlen()\n");
-		best_match_len = strmatchlen(vendorTable[current].mac, mac);
+		best_match_len = strmatchlen(VT_MAC(db, current), mac);
 		// printf("exited strmatchlen()\n");
 		do {
 			// printf("1: current=%d match_len=%d best_match_len=%d\n", current, match_len, best_match_len);
 			current ++;
-			// printf("1: current=%d match_len=%d best_match_len=%d mac='%s' vendor='%s'\n", current, match_len, best_match_len, vendorTable[current].mac, vendorTable[current].vendor);
-			match_len = strmatchlen(vendorTable[current].mac, mac);
+			// printf("1: current=%d match_len=%d best_match_len=%d mac='%s' vendor='%s'\n", current, match_len, best_match_len, VT_MAC(db, current), VT_VENDOR(db, current));
+			match_len = strmatchlen(VT_MAC(db, current), mac);
 			if (match_len > best_match_len) {
 				best_match = current;
 				best_match_len = match_len;
 			}
-			// printf("2: current=%d match_len=%d best_match_len=%d mac='%s' vendor='%s'\n", current, match_len, best_match_len, vendorTable[current].mac, vendorTable[current].vendor);
-		} while (match_len >= best_match_len && current < n_vendors);
+			// printf("2: current=%d match_len=%d best_match_len=%d mac='%s' vendor='%s'\n", current, match_len, best_match_len, VT_MAC(db, current), VT_VENDOR(db, current));
+		} while (match_len >= best_match_len && current < db->n_vendors - 1);
 
-		// printf("returning 1 mac='%s' vndr='%s'\n", vendorTable[best_match].mac, vendorTable[best_match].vendor);
+		// printf("returning 1 mac='%s' vndr='%s'\n", VT_MAC(db, best_match), VT_VENDOR(db, best_match));
 	}
 
-	free(mac);
-	return vendorTable[best_match].vendor;
+	return VT_VENDOR(db, best_match);
 
 }
 
 const char *get_mac_by_vendor (char *vendor) {
-	for (int i = 0; i < n_vendors; i++) {
-		// printf("%d of %d\r", i, n_vendors);
-		// fflush(stdout);
-		if (strcmp(vendorTable[i].vendor, vendor) == 0) {
-			return vendorTable[i].mac;
-		}
-	}
-	return "Vendor not in the table";
+	const struct vendor_db *db = vendor_db_current();
+	long id = vendor_db_name_id(db, vendor);
+
+	if (id < 0 || db->name_first[id] == db->name_first[id + 1])
+		return "Vendor not in the table";
+	return VT_MAC(db, db->name_entries[db->name_first[id]]);
 }
 
-const char *get_vendor_by_mac_binary (const char *mac)
+const char *get_vendor_by_mac_binary (const char *mac_parm)
 {
+	const struct vendor_db *db = vendor_db_current();
 	int low = 0;
-	int high = n_vendors - 1;
+	int high;
 	int i = 0;
 	int best_match = -1;
 	int best_match_len;
 	int current, match_len = 0;
-	int last_i = 0;
+	char buf[HW_MAC_STR_LEN + 1];
+	const char *mac = mac_canonical(mac_parm, buf);
+
+	if (db == NULL || db->n_vendors == 0 || mac == NULL)
+		return "Unknown";
+	high = db->n_vendors - 1;
 
 	do {
-		last_i = i;
 		i = (low + high) / 2;
-		if (last_i == i && i < high)
-			i++;
-		else if (last_i == i) {
+		if (i == low) {
+			/* down to two neighbours and neither is a prefix of the MAC */
+			if (strmatchlen(mac, VT_MAC(db, high)) > strmatchlen(mac, VT_MAC(db, i)))
+				i = high;
 			best_match = i;
 			break;
 		}
-		// printf("%d of %ld low=%d high=%d\n", i, n_vendors, low, high);
-		// printf("BINARY: mac='%s' vT[%d].mac='%s' vendor='%s'\n", mac, i, vendorTable[i].mac, vendorTable[i].vendor);
-		if (strncmp(mac, vendorTable[i].mac, strnlen(vendorTable[i].mac, 8)) < 0)
+		// printf("%d of %ld low=%d high=%d\n", i, db->n_vendors, low, high);
+		// printf("BINARY: mac='%s' vT[%d].mac='%s' vendor='%s'\n", mac, i, VT_MAC(db, i), VT_VENDOR(db, i));
+		if (strncmp(mac, VT_MAC(db, i), strnlen(VT_MAC(db, i), 8)) < 0)
 			high = i;
-		else if (strncmp(mac, vendorTable[i].mac, strnlen(vendorTable[i].mac, 8)) > 0)
+		else if (strncmp(mac, VT_MAC(db, i), strnlen(VT_MAC(db, i), 8)) > 0)
 			low = i;
-		else if (strncmp(mac, vendorTable[i].mac, strnlen(vendorTable[i].mac, 8)) == 0) {
-			// return vendorTable[i].vendor;
+		else if (strncmp(mac, VT_MAC(db, i), strnlen(VT_MAC(db, i), 8)) == 0) {
+			// return VT_VENDOR(db, i);
 			best_match = i;
 			break;
 		}
@@ -434,30 +933,30 @@ const char *get_vendor_by_mac_binary (const char *mac)
 	if (best_match == -1)
 		return "Unknown";
 
-	while (strncmp(vendorTable[i].mac, mac, 8) == 0 && i > 0) {
-		// printf("BT: mac='%s' vT[%d].mac='%s' vendor='%s'\n", mac, i, vendorTable[i].mac, vendorTable[i].vendor);
+	while (strncmp(VT_MAC(db, i), mac, 8) == 0 && i > 0) {
+		// printf("BT: mac='%s' vT[%d].mac='%s' vendor='%s'\n", mac, i, VT_MAC(db, i), VT_VENDOR(db, i));
 		i--;
 	}
 
 	best_match = i;
 
 	current = best_match;
-	match_len = strmatchlen(vendorTable[current].mac, mac);
-	best_match_len = strmatchlen(vendorTable[current].mac, mac);
+	match_len = strmatchlen(VT_MAC(db, current), mac);
+	best_match_len = strmatchlen(VT_MAC(db, current), mac);
 
-	while (match_len >= best_match_len && current < n_vendors - 1) {
+	while (match_len >= best_match_len && current < db->n_vendors - 1) {
 		current ++;
-		match_len = strmatchlen(vendorTable[current].mac, mac);
-		// printf("SEEK: current=%d match_len=%d best_match_len=%d mac='%s' vendor='%s'\n", current, match_len, best_match_len, vendorTable[current].mac, vendorTable[current].vendor);
+		match_len = strmatchlen(VT_MAC(db, current), mac);
+		// printf("SEEK: current=%d match_len=%d best_match_len=%d mac='%s' vendor='%s'\n", current, match_len, best_match_len, VT_MAC(db, current), VT_VENDOR(db, current));
 		if (match_len > best_match_len) {
 			best_match = current;
 			best_match_len = match_len;
 		}
 	}
 
-	// printf("returning 2 %s\n", vendorTable[best_match].vendor);
+	// printf("returning 2 %s\n", VT_VENDOR(db, best_match));
 
-	return vendorTable[best_match].vendor;
+	return VT_VENDOR(db, best_match);
 }
 
 /* This version has disappointingly the same speed as get_vendor_by_mac_binary()
@@ -472,34 +971,42 @@ const char *get_vendor_by_mac_binary (const char *mac)
 
 */
 
-const char *get_vendor_by_mac_binary_ulmac (char *mac_parm)
+const char *get_vendor_by_mac_binary_ulmac (const char *mac_parm)
 {
+	const struct vendor_db *db = vendor_db_current();
 	int low = 0;
-	int high = n_vendors - 1;
+	int high;
 	int i = 0;
 	int best_match = -1;
 	int best_match_len;
 	int current, match_len = 0;
-	char *mac = strtoupper(mac_parm);
-	unsigned long long my_ulmac = ulmac(mac);
+	char buf[HW_MAC_STR_LEN + 1];
+	const char *mac = mac_canonical(mac_parm, buf);
+	unsigned long long my_ulmac;
+
+	if (db == NULL || db->n_vendors < 2 || mac == NULL)
+		return "Unknown";
+	high = db->n_vendors - 1;
+
+	my_ulmac = ulmac(mac);
 
 	do {
 		i = (low + high) / 2;
 		if (i == low) {
-			if (strmatchlen(mac, vendorTable[i].mac) > strmatchlen(mac, vendorTable[i+1].mac))
+			if (strmatchlen(mac, VT_MAC(db, i)) > strmatchlen(mac, VT_MAC(db, i+1)))
 				best_match = i;
 			else
 				best_match = i + 1;
 			break;
 		}
-		// printf("%d of %ld low=%d high=%d\n", i, n_vendors, low, high);
-		// printf("BINARY: mac='%s' vT[%d].mac='%s' vendor='%s'\n", mac, i, vendorTable[i].mac, vendorTable[i].vendor);
-		if	(my_ulmac <  vendorTable[i].ulmac)
+		// printf("%d of %ld low=%d high=%d\n", i, db->n_vendors, low, high);
+		// printf("BINARY: mac='%s' vT[%d].mac='%s' vendor='%s'\n", mac, i, VT_MAC(db, i), VT_VENDOR(db, i));
+		if	(my_ulmac <  VT_PREFIX(db, i) >> 24)
 			high = i;
-		else if (my_ulmac >  vendorTable[i].ulmac)
+		else if (my_ulmac >  VT_PREFIX(db, i) >> 24)
 			low = i;
-		else if (my_ulmac == vendorTable[i].ulmac) {
-			// return vendorTable[i].vendor;
+		else if (my_ulmac == VT_PREFIX(db, i) >> 24) {
+			// return VT_VENDOR(db, i);
 			best_match = i;
 			break;
 		}
@@ -510,434 +1017,1952 @@ const char *get_vendor_by_mac_binary_ulmac (char *mac_parm)
 	if (best_match == -1)
 		return "Unknown";
 
-	// while ((my_ulmac & 0x00fff000) == (vendorTable[i].ulmac & 0x00fff000) && i > 0) {
-	while (strncmp(vendorTable[i].mac, mac, 8) == 0 && i > 0) {
-		// printf("BT: mac='%s' vT[%d].mac='%s' vendor='%s'\n", mac, i, vendorTable[i].mac, vendorTable[i].vendor);
+	// while ((my_ulmac & 0x00fff000) == (VT_PREFIX(db, i) >> 24 & 0x00fff000) && i > 0) {
+	while (strncmp(VT_MAC(db, i), mac, 8) == 0 && i > 0) {
+		// printf("BT: mac='%s' vT[%d].mac='%s' vendor='%s'\n", mac, i, VT_MAC(db, i), VT_VENDOR(db, i));
 		i--;
 	}
 	best_match = i;
 
 
 	current = best_match;
-	match_len = strmatchlen(vendorTable[current].mac, mac);
-	best_match_len = strmatchlen(vendorTable[current].mac, mac);
+	match_len = strmatchlen(VT_MAC(db, current), mac);
+	best_match_len = strmatchlen(VT_MAC(db, current), mac);
 
-	while (match_len >= best_match_len && current < n_vendors - 1) {
+	while (match_len >= best_match_len && current < db->n_vendors - 1) {
 		current ++;
-		match_len = strmatchlen(vendorTable[current].mac, mac);
-		// printf("SEEK: current=%d match_len=%d best_match_len=%d mac='%s' vendor='%s'\n", current, match_len, best_match_len, vendorTable[current].mac, vendorTable[current].vendor);
+		match_len = strmatchlen(VT_MAC(db, current), mac);
+		// printf("SEEK: current=%d match_len=%d best_match_len=%d mac='%s' vendor='%s'\n", current, match_len, best_match_len, VT_MAC(db, current), VT_VENDOR(db, current));
 		if (match_len > best_match_len) {
 			best_match = current;
 			best_match_len = match_len;
 		}
 	}
 
-	// printf("returning 2 %s\n", vendorTable[best_match].vendor);
+	// printf("returning 2 %s\n", VT_VENDOR(db, best_match));
 
-	return vendorTable[best_match].vendor;
+	return VT_VENDOR(db, best_match);
 }
 
-void sort_vendor_table(void)
-{
-	for (int i = 0; i < n_vendors; i++)
-		for (int j = i + 1; j < n_vendors; j ++)
-			if (strcmp(vendorTable[i].mac, vendorTable[j].mac) < 0)
-				SWAPXY(vendorTable[i], vendorTable[j]);
-}
+/* The number of level 24 nodes and of level 28 and 36 blocks the sorted
+   table needs. */
 
-int vendor_initialise(const char *mac_vendor_list)
+static void trie_count(const struct vendor_db *db, uint32_t *n24, uint32_t *n28, uint32_t *n36)
 {
-	FILE  *fvendor;
-	size_t n = 200;
-	char *line = (char *) malloc(n);
-	int ret = 0;
+	unsigned long long last_oui = ~0ULL, last_l28 = ~0ULL, last_l36 = ~0ULL;
 
-	if ((fvendor = fopen(mac_vendor_list, "r")) == NULL) {
-		perror("fopen");
-		return -1;
-	}
+	*n24 = *n28 = *n36 = 0;
 
-	max_vendors = MAX_VENDORS_INIT;
+	for (size_t i = 0; i < db->n_vendors; i++) {
+		unsigned long long p = VT_PREFIX(db, i);
 
-	vendorTable = (struct mac_vendor *) calloc (max_vendors, sizeof(struct mac_vendor));
-	if (!vendorTable)
-		return -ENOMEM;
-	
-	ret = getline(&line, &n, fvendor);
-
-	while ((ret = getline(&line, &n, fvendor) != -1)) {
-		char *pdelim1 = NULL, *pdelim2 = NULL;
-		char *mac, *vendor;
-		
-		// The vendor file format is ^mac,vendor,true|false,format,date$
-		//			  or ^mac,"vendor, Ltd.",true|false,format,date$
-
-		// fprintf(stderr, "Line %5d: %s\n", n_vendors, line);
-
-		if ((pdelim1 = strchr(line, ','))) {
-			*pdelim1++ = '\0';
-			mac = line;
-			// fprintf(stderr, "mac='%s'\n", mac);
-			if (*(pdelim1) == '"') {
-				pdelim1++;
-				if (!(pdelim2 = strchr(pdelim1, '"')) || !(*(pdelim2 + 1) == ','))
-					goto error;
-			} else if (!(pdelim2 = strchr(pdelim1, ',')))
-				goto error;
-			*pdelim2 = '\0';
-			vendor = pdelim1;
-			// fprintf(stderr, "vendor='%s'\n", vendor);
-			if ((vendorTable[n_vendors].mac    = strdup(mac   )) == NULL ||
-			    (vendorTable[n_vendors].vendor = strdup(vendor)) == NULL)
-				return -ENOMEM;
-			else {
-				vendorTable[n_vendors].ulmac = ulmac(mac);
-				if (n_vendors >= max_vendors) {
-					max_vendors += vend_increment;
-					vendorTable = (struct mac_vendor *) realloc (vendorTable, max_vendors * sizeof(struct mac_vendor));
-				}
-			}
-		} else
-			goto error;
-// 		printf("vT[%ld].mac='%s', vT[%ld].vendor='%s'\n",
-// 			n_vendors, vendorTable[n_vendors].mac,
-// 			n_vendors, vendorTable[n_vendors].vendor);
-		n_vendors ++;
+		if (p >> 24 != last_oui)
+			++*n24, last_oui = p >> 24;
+		if (VT_BITS(db, i) > 24 && p >> 24 != last_l28)
+			++*n28, last_l28 = p >> 24;
+		if (VT_BITS(db, i) > 28 && p >> 20 != last_l36)
+			++*n36, last_l36 = p >> 20;
 	}
-
-	if (errno)
-		perror("getline");
-
-	fclose(fvendor);
-
-	printf("Sorting vendor table ... ");
-	fflush(stdout);
-	// sort_vendor_table();
-	// qsort (vendorTable, sizeof(struct mac_vendor), n_vendors, vendor_entry_compare);
-	quickSort(vendorTable, 0, n_vendors - 1);
-	printf("done.\n");
-	printf("Populating hash table ... ");
-	fflush(stdout);
-	hash_bucket = (struct mac_vendor_list *) calloc (NO_BUCKETS, sizeof(struct mac_vendor_list));
-	printf("Allocated hash table ... ");
-	fflush(stdout);
-	hash_populate(hash_bucket, vendorTable);
-	printf("done.\n");
-	int min_n = MAXINT, max_n = 0, sum = 0;
-	for (int i = 0; i < NO_BUCKETS; i++) {
-		if (hash_bucket[i].n < min_n)
-			min_n = hash_bucket[i].n;
-		if (hash_bucket[i].n > max_n)
-			max_n = hash_bucket[i].n;
-		sum += hash_bucket[i].n;
-	}
-	printf("hash_table: min/bucket=%d max/bucket=%d avg/bucket=%d\n", min_n, max_n, sum/NO_BUCKETS);
-//	exit(1);
-
-	return n_vendors;
-
-error:
-	free (vendorTable);
-	fclose(fvendor);
-	fprintf(stderr, "MAC: format error in line %ld\n", n_vendors + 1);
-	return -EVENDORFORMAT;
-
 }
 
-#ifdef DEVELOP_MAC_TABLE
+/* Build the trie from the sorted table into the image in a. */
 
-int main (int argc, char *argv[])
+static int trie_build(struct vendor_db *db, struct vendor_arena *a)
 {
-	char *mac_vendors_file = "mac-vendors-export.csv";
-	size_t n = 0;
-	int    err = 0;
+	uint32_t n24, n28, n36;
+	unsigned long long last_oui = ~0ULL;
 
-	if ((n = vendor_initialise(mac_vendors_file)) <= 0)
-		fprintf(stderr, "%s: Problem processing mac vendors list.\n", mac_vendors_file);
+	trie_count(db, &n24, &n28, &n36);
 
-	printf ("Having read %ld entries.\n", n);
-/*
-	for (int i = 0; i < n; i++)
-		printf("%-20s %s\n", vendorTable[i].mac, vendorTable[i].vendor);
-*/
+	db->trie_dir = (uint32_t *) arena_section(a, VIS_TRIE_DIR, sizeof(uint32_t), TRIE_DIR_SIZE + 1);
+	db->trie_lo  = (uint8_t *) arena_section(a, VIS_TRIE_LO, sizeof(uint8_t), n24);
+	db->trie_l24 = (struct trie_node *) arena_section(a, VIS_TRIE_L24, sizeof(struct trie_node), n24);
+	db->trie_l28 = (struct trie_node *) arena_section(a, VIS_TRIE_L28, sizeof(struct trie_node), n28 * TRIE_L28_FANOUT);
+	db->trie_l36 = (uint32_t *) arena_section(a, VIS_TRIE_L36, sizeof(uint32_t), n36 * TRIE_L36_FANOUT);
+	if (!db->trie_dir || !db->trie_lo || !db->trie_l24 || !db->trie_l28 || !db->trie_l36)
+		return -ENOMEM;
 
-	unsigned long long ts1, te1, ts2, te2;
+	db->n_trie_l24 = db->n_trie_l28 = db->n_trie_l36 = 0;
 
-	char long_mac[18] = "FF:FF:FF:FF:FF:FF";
-	char *mac = (char *) calloc(1, 18);
+	for (size_t i = 0; i < db->n_vendors; i++) {
+		unsigned long long p = VT_PREFIX(db, i);
+		struct trie_node *node, *node28;
 
-#define COMMENTED_CODE
-#ifdef COMMENTED_CODE
-	printf("Starting get_vendor_by_mac() test ... ");
-	fflush(stdout);
+		if (p >> 24 != last_oui) {
+			last_oui = p >> 24;
+			db->trie_lo[db->n_trie_l24] = last_oui & 0xff;
+			db->trie_dir[(last_oui >> 8) + 1] = ++db->n_trie_l24;
+		}
+		node = &db->trie_l24[db->n_trie_l24 - 1];
 
-	ts1 = time_nanoseconds();
+		if (VT_BITS(db, i) == 24) {
+			node->entry = i + 1;
+			continue;
+		}
 
-	for (int i = 0; i < n; i++) {
-		char *mac = vendorTable[i].mac;
-		char *vendor = get_vendor_by_mac(mac);
+		if (!node->child)
+			node->child = ++db->n_trie_l28;
+		node28 = &db->trie_l28[(node->child - 1) * TRIE_L28_FANOUT + (p >> 20 & 0xf)];
 
-		// `printf("%d of %ld: mac='%s' vendor='%s'\r", i, n, mac, vendor = hashtable_get_vendor_by_mac(mac));
-		// fflush(stdout);
-		if (strcmp(vendor, vendorTable[i].vendor) != 0) {
-			fprintf(stderr, "%d: '%s' -> '%s' != '%s' -> '%s'!\n", i,
-								get_mac_by_vendor(vendor),
-								vendor,
-								vendorTable[i].mac,
-								vendorTable[i].vendor);
-			err ++;
+		if (VT_BITS(db, i) == 28) {
+			node28->entry = i + 1;
+			continue;
 		}
-	}
 
-	printf ("done.\nHaving found %d errors.\n", err);
-	printf ("Duration = %lld\n", time_nanoseconds() - ts1);
+		if (!node28->child)
+			node28->child = ++db->n_trie_l36;
+		db->trie_l36[(node28->child - 1) * TRIE_L36_FANOUT + (p >> 12 & 0xff)] = i + 1;
+	}
 
-	printf("Starting get_vendor_by_mac() full mac test ... ");
-	fflush(stdout);
+	/* groups without OUIs start where the previous group ended */
+	for (int i = 1; i <= TRIE_DIR_SIZE; i++)
+		if (db->trie_dir[i] < db->trie_dir[i - 1])
+			db->trie_dir[i] = db->trie_dir[i - 1];
 
-	err = 0;
-	ts2 = time_nanoseconds();
+	return 0;
+}
 
-	for (int i = 0; i < n; i++) {
-		
-		strcpy(mac, long_mac);
-		strcpy(mac, vendorTable[i].mac);
+/* Returns the table index + 1 of the longest prefix of the first bits of
+   mac48, or 0. */
 
-		char *vendor = get_vendor_by_mac(mac);
-		// `printf("%d of %ld: mac='%s' vendor='%s'\r", i, n, mac, vendor = hashtable_get_vendor_by_mac(mac));
-		// fflush(stdout);
-		if (strcmp(vendor, vendorTable[i].vendor) != 0) {
-			fprintf(stderr, "%d: '%s' -> '%s' != '%s' -> '%s'!\n", i,
-								get_mac_by_vendor(vendor),
-								vendor,
-								vendorTable[i].mac,
-								vendorTable[i].vendor);
-			err ++;
-		}
-/*
-		if (strcmp (get_vendor_by_mac(mac), get_vendor_by_mac_binary(mac)) != 0) {
-			err ++;
-			printf("Error: ind=%d mac='%s' vendor1='%s' vendor2='%s'\n", i, mac,
-					get_vendor_by_mac(mac), get_vendor_by_mac_binary(mac));
-		}
-*/
+__attribute((pure))
+static inline uint32_t trie_lookup(const struct vendor_db *db, unsigned long long mac48, int bits)
+{
+	uint32_t oui = mac48 >> 24;
+	uint32_t lo = db->trie_dir[oui >> 8], hi = db->trie_dir[(oui >> 8) + 1];
+	const struct trie_node *node;
+	uint32_t best, e;
+
+	while (lo < hi && db->trie_lo[lo] < (oui & 0xff))
+		lo++;
+	if (lo == hi || db->trie_lo[lo] != (oui & 0xff))
+		return 0;
+
+	node = &db->trie_l24[lo];
+	best = node->entry;
+	if (node->child && bits >= 28) {
+		node = &db->trie_l28[(node->child - 1) * TRIE_L28_FANOUT + (mac48 >> 20 & 0xf)];
+		if (node->entry)
+			best = node->entry;
+		if (node->child && bits >= 36 &&
+		    (e = db->trie_l36[(node->child - 1) * TRIE_L36_FANOUT + (mac48 >> 12 & 0xff)]))
+			best = e;
 	}
 
-	printf ("Having found %d errors.\n", err);
-	printf ("Duration = %lld\n", time_nanoseconds() - ts2);
+	return best;
+}
+
+static inline unsigned long long bssid_mac48(const uint8_t b[6])
+{
+	return (unsigned long long) b[0] << 40 | (unsigned long long) b[1] << 32 |
+	       (unsigned long long) b[2] << 24 | (unsigned long long) b[3] << 16 |
+	       (unsigned long long) b[4] << 8  | b[5];
+}
 
-#endif /* COMMENTED CODE */
+/* The counters are the one part of a published table that is written, hence
+   the cast. */
 
-	printf("Starting get_vendor_by_mac_hashtable() test ... ");
-	fflush(stdout);
+static inline void vendor_count(const struct vendor_db *db, uint64_t lookups, uint64_t hits)
+{
+	struct vendor_db *w = (struct vendor_db *) db;
 
-	err = 0;
-	ts2 = time_nanoseconds();
+	atomic_fetch_add_explicit(&w->counters.lookups, lookups, memory_order_relaxed);
+	if (hits)
+		atomic_fetch_add_explicit(&w->counters.hits, hits, memory_order_relaxed);
+}
 
-	for (int i = 0; i < n; i++) {
-		char *mac = vendorTable[i].mac;
-		char *vendor = get_vendor_by_mac_hashtable(mac);
-		
+/* The first of the n_dbs tables (in priority order) that has mac48 assigned
+   answers; the MAC is unassigned only if none of them does. */
 
-		// `printf("%d of %ld: mac='%s' vendor='%s'\r", i, n, mac, vendor = hashtable_get_vendor_by_mac(mac));
-		// fflush(stdout);
-		if (strcmp(vendor, vendorTable[i].vendor) != 0) {
-			fprintf(stderr, "%d: '%s' -> '%s' != '%s' -> '%s'!\n", i,
-								get_mac_by_vendor(vendor),
-								vendor,
-								vendorTable[i].mac,
-								vendorTable[i].vendor);
-			err ++;
+static const char *vendor_dbs_lookup(const struct vendor_db *const *dbs, size_t n_dbs,
+				     unsigned long long mac48, int bits, size_t *len)
+{
+	uint32_t e;
+
+	if (n_dbs == 0) {
+		if (len)
+			*len = sizeof("Unknown") - 1;
+		return "Unknown";
+	}
+
+	for (size_t i = 0; i < n_dbs; i++) {
+		const struct vendor_db *db = dbs[i];
+
+		e = oui_assigned(db, mac48) ? trie_lookup(db, mac48, bits) : 0;
+		if (atomic_load_explicit(&vendor_counting, memory_order_relaxed))
+			vendor_count(db, 1, e != 0);
+		if (e) {
+			if (len)
+				*len = VT_VENDOR_LEN(db, e - 1);
+			return VT_VENDOR(db, e - 1);
 		}
-/*
-		if (strcmp (get_vendor_by_mac(mac), get_vendor_by_mac_binary(mac)) != 0) {
-			err ++;
-			printf("Error: ind=%d mac='%s' vendor1='%s' vendor2='%s'\n", i, mac,
-					get_vendor_by_mac(mac), get_vendor_by_mac_binary(mac));
+	}
+
+	return mac_unassigned(mac48, len);
+}
+
+const char *vendor_db_lookup_mac(const struct vendor_db *const *dbs, size_t n_dbs, const char *mac)
+{
+	unsigned long long mac48;
+	int bits;
+
+	if ((bits = mac_prefix_parse(mac, &mac48)) < 24)
+		return "Unknown";
+
+	return vendor_dbs_lookup(dbs, n_dbs, mac48, bits, NULL);
+}
+
+const char *get_vendor_by_mac_trie (const char *mac)
+{
+	const struct vendor_db *db = vendor_db_current();
+
+	return vendor_db_lookup_mac(&db, db != NULL, mac);
+}
+
+/* The allocation-free entry point for the UI: no string formatting, no
+   parsing, no case folding, and the length comes with the answer. */
+
+const char *vendor_db_lookup(const struct vendor_db *const *dbs, size_t n_dbs, const uint8_t bssid[6], size_t *len)
+{
+	return vendor_dbs_lookup(dbs, n_dbs, bssid_mac48(bssid), 48, len);
+}
+
+const char *get_vendor_by_bssid (const uint8_t bssid[6], size_t *len)
+{
+	const struct vendor_db *db = vendor_db_current();
+
+	return vendor_db_lookup(&db, db != NULL, bssid, len);
+}
+
+/* One table's part of vendor_db_lookup_macs(): the bitmap test and trie walk
+   for the m MACs whose vendor is still NULL, done a level at a time,
+   prefetching every key's next node before touching any of them, so that the
+   cache misses overlap instead of forming one dependent chain per MAC. Fills
+   in the vendors db knows and returns how many. */
+
+static int trie_lookup_batch(const struct vendor_db *db, const unsigned long long *mac48, int m,
+			     const char **vendors, size_t *lens)
+{
+	uint32_t lo[TRIE_BATCH], hi[TRIE_BATCH], best[TRIE_BATCH];
+	const struct trie_node *node[TRIE_BATCH];
+	uint8_t assigned[TRIE_BATCH];
+	int found = 0;
+
+	for (int k = 0; k < m; k++) {
+		best[k] = 0;
+		node[k] = NULL;
+		if (!vendors[k])
+			__builtin_prefetch(&db->oui_map[mac48[k] >> 30]);
+	}
+
+	/* the bitmap weeds out unassigned OUIs */
+	for (int k = 0; k < m; k++)
+		if ((assigned[k] = !vendors[k] && oui_assigned(db, mac48[k])))
+			__builtin_prefetch(&db->trie_dir[mac48[k] >> 32]);
+
+	/* level 24: directory, then the low OUI bytes */
+	for (int k = 0; k < m; k++) {
+		if (!assigned[k]) {
+			lo[k] = hi[k] = 0;
+			continue;
+		}
+		lo[k] = db->trie_dir[mac48[k] >> 32];
+		hi[k] = db->trie_dir[(mac48[k] >> 32) + 1];
+		__builtin_prefetch(&db->trie_lo[lo[k]]);
+	}
+	for (int k = 0; k < m; k++) {
+		uint8_t oui_lo = mac48[k] >> 24 & 0xff;
+
+		while (lo[k] < hi[k] && db->trie_lo[lo[k]] < oui_lo)
+			lo[k]++;
+		if (lo[k] < hi[k] && db->trie_lo[lo[k]] == oui_lo) {
+			node[k] = &db->trie_l24[lo[k]];
+			__builtin_prefetch(node[k]);
 		}
-*/
 	}
 
-	printf ("done.\nHaving found %d errors.\n", err);
-	printf ("Duration = %lld\n", time_nanoseconds() - ts2);
+	/* level 28 */
+	for (int k = 0; k < m; k++) {
+		if (!node[k])
+			continue;
+		best[k] = node[k]->entry;
+		if (node[k]->child) {
+			node[k] = &db->trie_l28[(node[k]->child - 1) * TRIE_L28_FANOUT + (mac48[k] >> 20 & 0xf)];
+			__builtin_prefetch(node[k]);
+		} else
+			node[k] = NULL;
+	}
 
-	printf("Starting get_vendor_by_mac_hashtable() full mac test ... ");
-	fflush(stdout);
+	/* level 36 */
+	for (int k = 0; k < m; k++) {
+		if (!node[k])
+			continue;
+		if (node[k]->entry)
+			best[k] = node[k]->entry;
+		if (node[k]->child) {
+			lo[k] = (node[k]->child - 1) * TRIE_L36_FANOUT + (mac48[k] >> 12 & 0xff);
+			__builtin_prefetch(&db->trie_l36[lo[k]]);
+		} else
+			node[k] = NULL;
+	}
+	for (int k = 0; k < m; k++) {
+		if (node[k] && db->trie_l36[lo[k]])
+			best[k] = db->trie_l36[lo[k]];
+		if (best[k])
+			__builtin_prefetch(&db->table[best[k] - 1]);
+	}
+	for (int k = 0; k < m; k++)
+		if (best[k])
+			__builtin_prefetch(&db->names[db->table[best[k] - 1].name]);
+
+	for (int k = 0; k < m; k++) {
+		if (!best[k])
+			continue;
+		vendors[k] = VT_VENDOR(db, best[k] - 1);
+		if (lens)
+			lens[k] = VT_VENDOR_LEN(db, best[k] - 1);
+		found++;
+	}
 
-	err = 0;
-	ts2 = time_nanoseconds();
+	return found;
+}
 
-	for (int i = 0; i < n; i++) {
-		
-		strcpy(mac, long_mac);
-		strcpy(mac, vendorTable[i].mac);
+/* Batch version of vendor_db_lookup(), TRIE_BATCH keys at a time. Returns how
+   many MACs had a known vendor. */
 
-		char *vendor = get_vendor_by_mac_hashtable(mac);
-		// `printf("%d of %ld: mac='%s' vendor='%s'\r", i, n, mac, vendor = hashtable_get_vendor_by_mac(mac));
-		// fflush(stdout);
-		if (strcmp(vendor, vendorTable[i].vendor) != 0) {
-			fprintf(stderr, "%d: '%s' -> '%s' != '%s' -> '%s'!\n", i,
-								get_mac_by_vendor(vendor),
-								vendor,
-								vendorTable[i].mac,
-								vendorTable[i].vendor);
-			err ++;
+size_t vendor_db_lookup_macs(const struct vendor_db *const *dbs, size_t n_dbs,
+			     const uint8_t *macs, size_t stride, size_t n, const char **vendors, size_t *lens)
+{
+	unsigned long long mac48[TRIE_BATCH];
+	size_t found = 0;
+
+	for (size_t base = 0; base < n; base += TRIE_BATCH) {
+		int m = n - base < TRIE_BATCH ? n - base : TRIE_BATCH;
+		int left = m;
+
+		for (int k = 0; k < m; k++) {
+			mac48[k] = bssid_mac48(macs + (base + k) * stride);
+			vendors[base + k] = NULL;
 		}
+
+		for (size_t i = 0; i < n_dbs && left > 0; i++) {
+			int hits = trie_lookup_batch(dbs[i], mac48, m, vendors + base, lens ? lens + base : NULL);
+
+			if (atomic_load_explicit(&vendor_counting, memory_order_relaxed))
+				vendor_count(dbs[i], left, hits);
+			left -= hits;
+		}
+		found += m - left;
+
+		for (int k = 0; k < m; k++) {
+			if (vendors[base + k])
+				continue;
+			if (n_dbs == 0) {
+				vendors[base + k] = "Unknown";
+				if (lens)
+					lens[base + k] = sizeof("Unknown") - 1;
+			} else
+				vendors[base + k] = mac_unassigned(mac48[k], lens ? &lens[base + k] : NULL);
+		}
+	}
+
+	return found;
+}
+
+size_t get_vendors_by_macs (const uint8_t *macs, size_t stride, size_t n, const char **vendors, size_t *lens)
+{
+	const struct vendor_db *db = vendor_db_current();
+
+	return vendor_db_lookup_macs(&db, db != NULL, macs, stride, n, vendors, lens);
+}
+
 /*
-		if (strcmp (get_vendor_by_mac(mac), get_vendor_by_mac_binary(mac)) != 0) {
-			err ++;
-			printf("Error: ind=%d mac='%s' vendor1='%s' vendor2='%s'\n", i, mac,
-					get_vendor_by_mac(mac), get_vendor_by_mac_binary(mac));
+ * Reverse lookups
+ *
+ * Names are numbered 0 .. n_names - 1 in each table. The prefixes of a name
+ * come as MAC48 ranges, so "every Cisco BSSID around" is a range test per
+ * scan result instead of a vendor lookup and a string compare.
+ */
+
+__attribute((const))
+static inline unsigned char ascii_lower(unsigned char c)
+{
+	return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+/* Letters regardless of case are 0-25, and every other byte shares 26-31
+   with others; the search checks every name it finds anyway. */
+
+__attribute((const))
+static inline uint32_t trigram_symbol(unsigned char c)
+{
+	c = ascii_lower(c);
+	if (c >= 'a' && c <= 'z')
+		return c - 'a';
+	return 26 + c % 6;
+}
+
+__attribute((pure))
+static inline uint32_t trigram_key(const char *p)
+{
+	return trigram_symbol(p[0]) << 10 | trigram_symbol(p[1]) << 5 | trigram_symbol(p[2]);
+}
+
+/* Case insensitive (ASCII) search for pat in the len bytes at s. */
+
+__attribute((pure))
+static int name_contains(const char *s, size_t len, const char *pat, size_t plen)
+{
+	unsigned char first = ascii_lower(pat[0]);
+
+	if (plen == 0)
+		return 1;
+
+	for (size_t i = 0; i + plen <= len; i++) {
+		size_t j = 1;
+
+		if (ascii_lower(s[i]) != first)
+			continue;
+		while (j < plen && ascii_lower(s[i + j]) == ascii_lower(pat[j]))
+			j++;
+		if (j == plen)
+			return 1;
+	}
+
+	return 0;
+}
+
+/* Builds name_first[] and name_entries[]: a counting sort of the entries by
+   name, which keeps them in table order within a name. */
+
+static int name_index_build(struct vendor_db *db, struct vendor_arena *a)
+{
+	db->name_first   = (uint32_t *) arena_section(a, VIS_NAME_FIRST, sizeof(uint32_t), db->n_names + 1);
+	db->name_entries = (uint32_t *) arena_section(a, VIS_NAME_ENTRIES, sizeof(uint32_t), db->n_vendors);
+	if (!db->name_first || !db->name_entries)
+		return -ENOMEM;
+
+	for (size_t i = 0; i < db->n_vendors; i++)
+		db->name_first[db->table[i].name + 1]++;
+	for (uint32_t i = 0; i < db->n_names; i++)
+		db->name_first[i + 1] += db->name_first[i];
+	for (size_t i = 0; i < db->n_vendors; i++)
+		db->name_entries[db->name_first[db->table[i].name]++] = i;
+	/* each name_first[i] now points where the next name starts */
+	for (uint32_t i = db->n_names; i > 0; i--)
+		db->name_first[i] = db->name_first[i - 1];
+	db->name_first[0] = 0;
+
+	return 0;
+}
+
+/* Upper bound of the trigrams of all names, for sizing the image. */
+
+static size_t trigram_count(const struct vendor_db *db)
+{
+	size_t n = 0;
+
+	for (uint32_t i = 0; i < db->n_names; i++)
+		if (db->names[i].len >= 3)
+			n += db->names[i].len - 2;
+	return n;
+}
+
+/* A counting sort by trigram: count the names containing each trigram, lay
+   the lists out in key order, then fill them in, name by name, so that every
+   list is in name order. last[] keeps a name from being listed twice. */
+
+static int trigram_build(struct vendor_db *db, struct vendor_arena *a)
+{
+	struct vendor_arena scratch;
+	uint32_t *count, *last;
+	uint32_t n_keys = 0, n_lists = 0;
+
+	if (arena_map(&scratch, 2 * IMAGE_ALIGN((TRIGRAM_KEYS + 1) * sizeof(uint32_t))) < 0)
+		return -ENOMEM;
+	count = (uint32_t *) arena_alloc(&scratch, (TRIGRAM_KEYS + 1) * sizeof(uint32_t));
+	last  = (uint32_t *) arena_alloc(&scratch, (TRIGRAM_KEYS + 1) * sizeof(uint32_t));
+
+	for (uint32_t i = 0; i < db->n_names; i++) {
+		const char *name = db->strings + db->names[i].off;
+		uint32_t key = 0;
+
+		for (uint32_t j = 0; j < db->names[i].len; j++) {
+			key = (key << 5 | trigram_symbol(name[j])) & (TRIGRAM_KEYS - 1);
+			if (j >= 2 && last[key] != i + 1) {
+				last[key] = i + 1;
+				n_keys += count[key]++ == 0;
+				n_lists++;
+			}
 		}
-*/
 	}
 
-	printf ("done.\nHaving found %d errors.\n", err);
-	printf ("Duration = %lld\n", time_nanoseconds() - ts2);
+	db->trigrams      = (struct trigram *) arena_section(a, VIS_TRIGRAMS, sizeof(struct trigram), n_keys + 1);
+	db->trigram_names = (uint32_t *) arena_section(a, VIS_TRIGRAM_NAMES, sizeof(uint32_t), n_lists);
+	if (!db->trigrams || !db->trigram_names) {
+		arena_unmap(&scratch);
+		return -ENOMEM;
+	}
 
-	printf("Starting get_vendor_by_mac_binary() test ... ");
-	fflush(stdout);
+	/* count[] becomes where the next name of each list goes */
+	n_keys = n_lists = 0;
+	for (uint32_t key = 0; key < TRIGRAM_KEYS; key++) {
+		if (!count[key])
+			continue;
+		db->trigrams[n_keys++] = (struct trigram) { key, n_lists };
+		n_lists += count[key];
+		count[key] = n_lists - count[key];
+	}
+	db->trigrams[n_keys] = (struct trigram) { UINT32_MAX, n_lists };
+	db->n_trigrams = n_keys;
+
+	memset(last, 0, TRIGRAM_KEYS * sizeof(uint32_t));
+	for (uint32_t i = 0; i < db->n_names; i++) {
+		const char *name = db->strings + db->names[i].off;
+		uint32_t key = 0;
+
+		for (uint32_t j = 0; j < db->names[i].len; j++) {
+			key = (key << 5 | trigram_symbol(name[j])) & (TRIGRAM_KEYS - 1);
+			if (j >= 2 && last[key] != i + 1) {
+				last[key] = i + 1;
+				db->trigram_names[count[key]++] = i;
+			}
+		}
+	}
 
-	err = 0;
-	ts2 = time_nanoseconds();
+	arena_unmap(&scratch);
+	return 0;
+}
 
-	for (int i = 0; i < n; i++) {
-		char *mac = vendorTable[i].mac;
-		char *vendor = get_vendor_by_mac_binary(mac);
-		
+/* The names that may contain pat (plen bytes): the shortest trigram list of
+   pat, or NULL if all of them have to be scanned. *n is the length. */
 
-		// `printf("%d of %ld: mac='%s' vendor='%s'\r", i, n, mac, vendor = hashtable_get_vendor_by_mac(mac));
-		// fflush(stdout);
-		if (strcmp(vendor, vendorTable[i].vendor) != 0) {
-			fprintf(stderr, "%d: '%s' -> '%s' != '%s' -> '%s'!\n", i,
-								get_mac_by_vendor(vendor),
-								vendor,
-								vendorTable[i].mac,
-								vendorTable[i].vendor);
-			err ++;
+static const uint32_t *trigram_candidates(const struct vendor_db *db, const char *pat, size_t plen, uint32_t *n)
+{
+	const uint32_t *best = NULL;
+
+	*n = db->n_names;
+	if (plen < 3 || db->n_trigrams == 0)
+		return NULL;
+
+	for (size_t i = 0; i + 3 <= plen; i++) {
+		uint32_t key = trigram_key(pat + i), lo = 0, hi = db->n_trigrams;
+
+		while (lo < hi) {
+			uint32_t mid = lo + (hi - lo) / 2;
+
+			if (db->trigrams[mid].key < key)
+				lo = mid + 1;
+			else
+				hi = mid;
 		}
-/*
-		if (strcmp (get_vendor_by_mac(mac), get_vendor_by_mac_binary(mac)) != 0) {
-			err ++;
-			printf("Error: ind=%d mac='%s' vendor1='%s' vendor2='%s'\n", i, mac,
-					get_vendor_by_mac(mac), get_vendor_by_mac_binary(mac));
+		if (lo == db->n_trigrams || db->trigrams[lo].key != key) {
+			*n = 0;
+			return db->trigram_names;
+		}
+		if (!best || db->trigrams[lo + 1].first - db->trigrams[lo].first < *n) {
+			best = db->trigram_names + db->trigrams[lo].first;
+			*n = db->trigrams[lo + 1].first - db->trigrams[lo].first;
 		}
-*/
 	}
 
-	printf ("done.\nHaving found %d errors.\n", err);
-	printf ("Duration = %lld\n", time_nanoseconds() - ts2);
+	return best;
+}
+
+const char *vendor_db_name(const struct vendor_db *db, uint32_t id, size_t *len)
+{
+	if (!db || id >= db->n_names)
+		return NULL;
+	if (len)
+		*len = db->names[id].len;
+	return db->strings + db->names[id].off;
+}
+
+long vendor_db_name_id(const struct vendor_db *db, const char *vendor)
+{
+	size_t len = strlen(vendor);
+	const uint32_t *cand;
+	uint32_t n;
 
-	printf("Starting get_vendor_by_mac_binary() full mac test ... ");
-	fflush(stdout);
+	if (!db)
+		return -1;
 
-	err = 0;
-	ts2 = time_nanoseconds();
+	cand = trigram_candidates(db, vendor, len, &n);
+	for (uint32_t i = 0; i < n; i++) {
+		uint32_t id = cand ? cand[i] : i;
 
-	for (int i = 0; i < n; i++) {
-		
-		strcpy(mac, long_mac);
-		strcpy(mac, vendorTable[i].mac);
+		if (db->names[id].len == len && memcmp(db->strings + db->names[id].off, vendor, len) == 0)
+			return id;
+	}
 
-		char *vendor = get_vendor_by_mac_binary(mac);
-		// `printf("%d of %ld: mac='%s' vendor='%s'\r", i, n, mac, vendor = hashtable_get_vendor_by_mac(mac));
-		// fflush(stdout);
-		if (strcmp(vendor, vendorTable[i].vendor) != 0) {
-			fprintf(stderr, "%d: '%s' -> '%s' != '%s' -> '%s'!\n", i,
-								get_mac_by_vendor(vendor),
-								vendor,
-								vendorTable[i].mac,
-								vendorTable[i].vendor);
-			err ++;
+	return -1;
+}
+
+size_t vendor_db_search(const struct vendor_db *db, const char *pattern, uint32_t *ids, size_t max)
+{
+	size_t plen = strlen(pattern), found = 0;
+	const uint32_t *cand;
+	uint32_t n;
+
+	if (!db)
+		return 0;
+
+	cand = trigram_candidates(db, pattern, plen, &n);
+	for (uint32_t i = 0; i < n; i++) {
+		uint32_t id = cand ? cand[i] : i;
+
+		if (name_contains(db->strings + db->names[id].off, db->names[id].len, pattern, plen)) {
+			if (found < max)
+				ids[found] = id;
+			found++;
 		}
-/*
-		if (strcmp (get_vendor_by_mac(mac), get_vendor_by_mac_binary(mac)) != 0) {
-			err ++;
-			printf("Error: ind=%d mac='%s' vendor1='%s' vendor2='%s'\n", i, mac,
-					get_vendor_by_mac(mac), get_vendor_by_mac_binary(mac));
+	}
+
+	return found;
+}
+
+__attribute((const))
+static inline struct vendor_range prefix_range(uint64_t key)
+{
+	uint64_t prefix = key & 0xffffffffffffULL;
+
+	return (struct vendor_range) { prefix, prefix | ((1ULL << (48 - (key >> 48))) - 1) };
+}
+
+size_t vendor_db_name_prefixes(const struct vendor_db *db, uint32_t id, struct vendor_range *ranges, size_t max)
+{
+	uint32_t first, n;
+
+	if (!db || id >= db->n_names)
+		return 0;
+
+	first = db->name_first[id];
+	n = db->name_first[id + 1] - first;
+	for (uint32_t i = 0; i < n && i < max; i++)
+		ranges[i] = prefix_range(db->table[db->name_entries[first + i]].key);
+
+	return n;
+}
+
+/* Adds [first, last] to the ranges, merged with the previous one if they touch. */
+
+static void range_add(struct vendor_range *ranges, size_t max, size_t *n, struct vendor_range *prev,
+		      uint64_t first, uint64_t last)
+{
+	if (first > last)
+		return;
+	if (*n && prev->last + 1 == first) {
+		prev->last = last;
+		if (*n <= max)
+			ranges[*n - 1].last = last;
+		return;
+	}
+
+	*prev = (struct vendor_range) { first, last };
+	if (*n < max)
+		ranges[*n] = *prev;
+	++*n;
+}
+
+/* The MACs whose longest prefix match is a name containing pattern, as
+   sorted, disjoint ranges: one sweep over the table, which is in prefix order
+   with every block right after the blocks containing it, keeping a stack of
+   the blocks the sweep is in. A block of another vendor nested in a matching
+   one is left out, a later duplicate of a block wins, as in the lookups. */
+
+size_t vendor_db_search_ranges(const struct vendor_db *db, const char *pattern, struct vendor_range *ranges, size_t max)
+{
+	size_t n_ids, n = 0;
+	uint32_t *ids;
+	uint8_t *match;
+	struct vendor_range prev = { 0, 0 }, open[3];
+	uint8_t open_match[3];
+	uint64_t next = 0;	/* the first MAC not yet swept */
+	int depth = 0;
+
+	if (!db || (n_ids = vendor_db_search(db, pattern, NULL, 0)) == 0)
+		return 0;
+
+	if (!(ids = (uint32_t *) malloc(n_ids * sizeof(uint32_t))) ||
+	    !(match = (uint8_t *) calloc(db->n_names, 1))) {
+		free(ids);
+		return 0;
+	}
+	vendor_db_search(db, pattern, ids, n_ids);
+	for (size_t i = 0; i < n_ids; i++)
+		match[ids[i]] = 1;
+	free(ids);
+
+	for (size_t i = 0; i <= db->n_vendors; i++) {
+		struct vendor_range r = i < db->n_vendors ? prefix_range(db->table[i].key)
+							  : (struct vendor_range) { UINT64_MAX, UINT64_MAX };
+
+		/* leave the blocks that end before this one */
+		while (depth && open[depth - 1].last < r.first) {
+			depth--;
+			if (open_match[depth])
+				range_add(ranges, max, &n, &prev, next, open[depth].last);
+			next = open[depth].last + 1;
+		}
+		if (i == db->n_vendors)
+			break;
+		if (depth && open_match[depth - 1] && r.first > next)
+			range_add(ranges, max, &n, &prev, next, r.first - 1);
+		next = r.first;
+
+		if (depth && open[depth - 1].first == r.first && open[depth - 1].last == r.last)
+			open_match[depth - 1] = match[db->table[i].name];
+		else if (depth < 3) {
+			open[depth] = r;
+			open_match[depth++] = match[db->table[i].name];
 		}
-*/
 	}
 
-	printf ("done.\nHaving found %d errors.\n", err);
-	printf ("Duration = %lld\n", time_nanoseconds() - ts2);
+	free(match);
+	return n;
+}
+
+__attribute((pure))
+int vendor_ranges_match(const struct vendor_range *ranges, size_t n, const uint8_t bssid[6])
+{
+	uint64_t mac48 = bssid_mac48(bssid);
+	size_t lo = 0, hi = n;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (ranges[mid].last < mac48)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo < n && ranges[lo].first <= mac48;
+}
+
+/* The pool is sized for the whole file up front, see vendor_initialise(). */
+
+static long vendor_string_add(struct vendor_db *db, const char *s, size_t len)
+{
+	long off = db->strings_size;
+
+	if (db->strings_size + len + 1 > db->max_strings)
+		return -1;
+
+	memcpy(db->strings + db->strings_size, s, len);
+	db->strings[db->strings_size + len] = '\0';
+	db->strings_size += len + 1;
+
+	return off;
+}
+
+__attribute((pure))
+static uint64_t fnv1a64(const unsigned char *p, size_t len)
+{
+	uint64_t h = 0xcbf29ce484222325ULL;
+
+	while (len--) {
+		h ^= *p++;
+		h *= 0x100000001b3ULL;
+	}
+
+	return h;
+}
+
+/* Doubles the intern table, taking the new one from the loader's arena. The
+   old one is not given back, but the sizes form a geometric series, so all of
+   them together take less than twice the last one. */
+
+static int name_intern_grow(struct vendor_db *db)
+{
+	size_t mask = db->name_intern_mask ? 2 * db->name_intern_mask + 1 : NAME_INTERN_INIT - 1;
+	uint32_t *table = (uint32_t *) arena_alloc(db->name_intern_arena, (mask + 1) * sizeof(uint32_t));
+
+	if (!table)
+		return -ENOMEM;
+
+	for (uint32_t id = 1; id <= db->n_names; id++) {
+		const struct vendor_name *vn = &db->names[id - 1];
+		size_t i = (uint32_t) fnv1a64((const unsigned char *) db->strings + vn->off, vn->len) & mask;
+
+		while (table[i])
+			i = (i + 1) & mask;
+		table[i] = id;
+	}
+
+	db->name_intern = table;
+	db->name_intern_mask = mask;
+	return 0;
+}
+
+/* Returns the id of the name, whose hash is (uint32_t) fnv1a64(), adding it
+   to the names and the string pool the first time it is seen, or -1 when
+   out of room. */
+
+static long vendor_name_intern(struct vendor_db *db, const char *name, size_t len, uint32_t hash)
+{
+	size_t i;
+	uint32_t id;
+	long off;
+
+	if (2 * (db->n_names + 1) > db->name_intern_mask + 1 && name_intern_grow(db) < 0)
+		return -1;
+
+	i = hash & db->name_intern_mask;
+
+	for (; (id = db->name_intern[i]); i = (i + 1) & db->name_intern_mask)
+		if (db->names[id - 1].len == len && memcmp(db->strings + db->names[id - 1].off, name, len) == 0)
+			return id - 1;
+
+	if ((off = vendor_string_add(db, name, len)) < 0)
+		return -1;
+
+	db->names[db->n_names] = (struct vendor_name) { off, len };
+	db->name_intern[i] = ++db->n_names;
+	return db->n_names - 1;
+}
 
 /*
-	printf("Sorting vendor table ... ");
-	fflush(stdout);
-	// sort_vendor_table();
-	// qsort (vendorTable, sizeof(struct mac_vendor), n_vendors, vendor_entry_compare);
-	quickSort_ulmac(vendorTable, 0, n_vendors - 1);
-	printf("done.\n");
-*/
+ * Parallel CSV loader
+ *
+ * The CSV is mmap()-ed and cut at line boundaries into one chunk per CPU.
+ * Each thread parses its chunk into csv_lines, which only point back into the
+ * file, and sorts them; the caller then merges the sorted chunks, interning
+ * the names and filling the string pool, which is all that has to be serial.
+ * The getline() loop remains for files that cannot be mapped.
+ */
 
-	printf("Starting get_vendor_by_mac_binary_ulmac() test ... ");
-	fflush(stdout);
+#define CSV_MAX_THREADS	16
+#define CSV_MIN_CHUNK	(256 << 10)	/* not worth a thread below this */
 
-	err = 0;
-	ts2 = time_nanoseconds();
+struct csv_line {
+	uint64_t key;		/* HASH_KEY(prefix, bits) */
+	uint32_t mac;		/* offsets from the start of the line or file */
+	uint32_t name;
+	uint32_t hash;		/* of the name, for vendor_name_intern() */
+	uint16_t mac_len;
+	uint16_t name_len;
+};
 
-	for (int i = 0; i < n; i++) {
-		char *mac = vendorTable[i].mac;
-		char *vendor = get_vendor_by_mac_binary_ulmac(mac);
+struct csv_chunk {
+	const char *base;	/* of the mapped file */
+	const char *begin, *end;
+	struct csv_line *lines, *tmp;	/* tmp is room for radix_sort() */
+	size_t n_lines, max_lines;
+	int error;		/* stopped at line n_lines of the chunk */
+	int threaded;
+	uint64_t sort_ns;
+	pthread_t thread;
+};
 
-		// `printf("%d of %ld: mac='%s' vendor='%s'\r", i, n, mac, vendor = hashtable_get_vendor_by_mac(mac));
-		// fflush(stdout);
-		if (strcmp(vendor, vendorTable[i].vendor) != 0) {
-			fprintf(stderr, "%d: '%s' -> '%s' != '%s' -> '%s'!\n", i,
-								get_mac_by_vendor(vendor),
-								vendor,
-								vendorTable[i].mac,
-								vendorTable[i].vendor);
-			err ++;
+/* The vendor file format is ^mac,vendor,true|false,format,date$
+			  or ^mac,"vendor, Ltd.",true|false,format,date$
+   with the line in [line, end) and offsets in l taken from base. */
+
+static int csv_parse_line(const char *line, const char *end, const char *base, struct csv_line *l)
+{
+	const char *mac = line, *mac_end, *name, *name_end, *p;
+	unsigned long long prefix;
+	int bits, block_bits;
+
+	if (end > line && end[-1] == '\r')
+		end--;
+
+	if (!(mac_end = (const char *) memchr(line, ',', end - line)))
+		return -1;
+
+	if ((p = mac_end + 1) < end && *p == '"') {
+		name = ++p;
+		if (!(name_end = (const char *) memchr(p, '"', end - p)) || name_end + 1 >= end || name_end[1] != ',')
+			return -1;
+		p = name_end + 2;
+	} else {
+		name = p;
+		if (!(name_end = (const char *) memchr(p, ',', end - p)))
+			return -1;
+		p = name_end + 1;
+	}
+
+	/* skip the Private column */
+	if (!(p = (const char *) memchr(p, ',', end - p)))
+		return -1;
+	p++;
+
+	block_bits = block_type_bits(p, end - p);
+	bits = mac_prefix_parse_n(mac, mac_end - mac, &prefix);
+	if (bits != 24 && bits != 28 && bits != 36)
+		return -1;
+	if (block_bits && block_bits != bits)
+		return -1;
+	if (mac_end - mac > UINT16_MAX || name_end - name > UINT16_MAX)
+		return -1;
+
+	l->key      = HASH_KEY(prefix, bits);
+	l->mac      = mac - base;
+	l->mac_len  = mac_end - mac;
+	l->name     = name - base;
+	l->name_len = name_end - name;
+	l->hash     = fnv1a64((const unsigned char *) name, name_end - name);
+	return 0;
+}
+
+static void *csv_parse_chunk(void *arg)
+{
+	struct csv_chunk *c = (struct csv_chunk *) arg;
+	const char *eol;
+
+	for (const char *p = c->begin; p < c->end; p = eol + 1) {
+		if (!(eol = (const char *) memchr(p, '\n', c->end - p)))
+			eol = c->end;
+		if (c->n_lines == c->max_lines || csv_parse_line(p, eol, c->base, &c->lines[c->n_lines]) < 0) {
+			c->error = 1;
+			return NULL;
 		}
+		c->n_lines++;
+	}
+
+	c->sort_ns = vendor_clock_ns();
+	radix_sort(c->lines, c->n_lines, sizeof(struct csv_line), c->tmp);
+	c->sort_ns = vendor_clock_ns() - c->sort_ns;
+	return NULL;
+}
+
+/* Appends a parsed line to the table. */
+
+static int vendor_add_line(struct vendor_db *db, const struct csv_line *l, const char *base)
+{
+	long mac_off, name;
+
+	if (db->n_vendors >= db->max_vendors ||
+	    (mac_off = vendor_string_add(db, base + l->mac, l->mac_len)) < 0 ||
+	    (name    = vendor_name_intern(db, base + l->name, l->name_len, l->hash)) < 0)
+		return -1;
+
+	db->table[db->n_vendors].key  = l->key;
+	db->table[db->n_vendors].mac  = mac_off;
+	db->table[db->n_vendors].name = name;
+	db->n_vendors++;
+	return 0;
+}
+
+/* Loads the CSV in fd into the table of db, sorted. lines is room for twice
+   max_lines csv_lines. Returns the number of entries, -EVENDORFORMAT, or -1 if the file
+   could not be mapped. */
+
+static long vendor_load_csv_mmap(struct vendor_db *db, int fd, size_t size, struct csv_line *lines, size_t max_lines)
+{
+	struct csv_chunk chunk[CSV_MAX_THREADS];
+	size_t head[CSV_MAX_THREADS], line_no = 0;
+	const char *base, *p, *end;
+	long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	int n_chunks = size / CSV_MIN_CHUNK + 1;
+	uint64_t t = vendor_clock_ns(), sort_ns = 0;
+	long ret = 0;
+
+	if (n_chunks > n_cpus)
+		n_chunks = n_cpus > 0 ? n_cpus : 1;
+	if (n_chunks > CSV_MAX_THREADS)
+		n_chunks = CSV_MAX_THREADS;
+
+	base = (const char *) mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (base == MAP_FAILED)
+		return -1;
+	madvise((void *) base, size, MADV_SEQUENTIAL);
+	db->build_ns[VENDOR_PHASE_READ] += vendor_clock_ns() - t;
+	t = vendor_clock_ns();
+
+	/* skip the header line */
+	end = base + size;
+	p = (const char *) memchr(base, '\n', size);
+	p = p ? p + 1 : end;
+
+	for (int i = 0; i < n_chunks; i++) {
+		const char *cut = i == n_chunks - 1 ? end : p + (end - p) / (n_chunks - i);
+
+		if (cut < end && (cut = (const char *) memchr(cut, '\n', end - cut)))
+			cut++;
+		else
+			cut = end;
+
+		chunk[i] = (struct csv_chunk) { .base = base, .begin = p, .end = cut,
+						.lines = lines, .max_lines = (cut - p) / 9 + 1 };
+		chunk[i].tmp = lines + chunk[i].max_lines;
+		lines += 2 * chunk[i].max_lines;
+		if (lines > chunk[0].lines + 2 * max_lines) {
+			ret = -EVENDORFORMAT;
+			n_chunks = i;
+			goto out;
+		}
+		p = cut;
+	}
+
+	/* chunk 0 is ours */
+	for (int i = 1; i < n_chunks; i++)
+		chunk[i].threaded = pthread_create(&chunk[i].thread, NULL, csv_parse_chunk, &chunk[i]) == 0;
+	csv_parse_chunk(&chunk[0]);
+	for (int i = 1; i < n_chunks; i++)
+		if (chunk[i].threaded)
+			pthread_join(chunk[i].thread, NULL);
+		else
+			csv_parse_chunk(&chunk[i]);
+
+	/* the chunks sort in parallel, so the slowest one is what sorting took */
+	for (int i = 0; i < n_chunks; i++)
+		if (chunk[i].sort_ns > sort_ns)
+			sort_ns = chunk[i].sort_ns;
+	db->build_ns[VENDOR_PHASE_SORT] += sort_ns;
+
+	for (int i = 0; i < n_chunks; i++) {
+		if (chunk[i].error) {
+			vendor_error("MAC: format error in line %zu", line_no + chunk[i].n_lines + 1);
+			ret = -EVENDORFORMAT;
+			goto out;
+		}
+		line_no += chunk[i].n_lines;
+		head[i] = 0;
+	}
+
+	/* merge; there are few chunks, so a linear scan for the least head does,
+	   and taking the first of equal heads keeps duplicates in file order */
+	for (;;) {
+		int min = -1;
+
+		for (int i = 0; i < n_chunks; i++)
+			if (head[i] < chunk[i].n_lines &&
+			    (min < 0 || vendor_sort_key(chunk[i].lines[head[i]].key) < vendor_sort_key(chunk[min].lines[head[min]].key)))
+				min = i;
+		if (min < 0)
+			break;
+		if (vendor_add_line(db, &chunk[min].lines[head[min]++], base) < 0) {
+			vendor_error("MAC: vendor table overflow");
+			ret = -EVENDORFORMAT;
+			goto out;
+		}
+	}
+
+	ret = db->n_vendors;
+out:
+	munmap((void *) base, size);
+	db->build_ns[VENDOR_PHASE_PARSE] += vendor_clock_ns() - t - sort_ns;
+	return ret;
+}
+
+static int is_vendor_image(FILE *f)
+{
+	char magic[sizeof(((struct vendor_image_header *)0)->magic)];
+	int is_image = fread(magic, sizeof(magic), 1, f) == 1 &&
+		       memcmp(magic, VENDOR_IMAGE_MAGIC, sizeof(magic)) == 0;
+
+	rewind(f);
+	return is_image;
+}
+
+static const void *image_section(const struct vendor_image_header *hdr, uint32_t id, size_t elem_size, uint32_t *count)
+{
+	for (uint32_t i = 0; i < hdr->n_sections; i++) {
+		const struct vendor_image_section *sec = &hdr->section[i];
+
+		if (sec->id != id)
+			continue;
+		if (sec->offset < sizeof(*hdr) || sec->offset > hdr->image_size ||
+		    sec->size > hdr->image_size - sec->offset ||
+		    sec->size != (uint64_t) sec->count * elem_size)
+			return NULL;
+		*count = sec->count;
+		return (const char *) hdr + sec->offset;
+	}
+	return NULL;
+}
+
+/* Makes db use the image of size bytes at base in place. An image that is
+   not trusted is checked all through first, the checksum and every index
+   the lookups follow; a trusted one, such as the one built into the program,
+   only has its header and section table checked. */
+
+static int vendor_use_image(struct vendor_db *db, const void *base, size_t size, const char *name, int trusted)
+{
+	const struct vendor_image_header *hdr = (const struct vendor_image_header *) base;
+	const struct mac_vendor *entries;
+	const struct vendor_name *names;
+	const char *strings;
+	const uint32_t *dir, *l36, *first, *by_name, *tri_names;
+	const struct trigram *tri;
+	const uint8_t *lo;
+	const struct trie_node *l24, *l28;
+	const struct hash_slot *hash;
+	const uint64_t *map;
+	uint32_t n_map, n_entries, n_names_, n_strings, n_dir, n_lo, n_l24, n_l28, n_l36, n_hash, n_keys = 0, max_psl = 0;
+	uint32_t n_first, n_by_name, n_tri, n_tri_names;
+
+	if (size < sizeof(struct vendor_image_header) || (uintptr_t) base % VENDOR_IMAGE_ALIGN ||
+	    memcmp(hdr->magic, VENDOR_IMAGE_MAGIC, sizeof(VENDOR_IMAGE_MAGIC))) {
+		vendor_error("%s: not a vendor image", name);
+		return -EVENDORIMAGE;
+	}
+
+	if (hdr->byte_order != VENDOR_IMAGE_BYTE_ORDER || hdr->version != VENDOR_IMAGE_VERSION) {
+		vendor_error("%s: vendor image version %u is not supported (want %u)",
+			name, hdr->version, VENDOR_IMAGE_VERSION);
+		return -EVENDORIMAGE;
+	}
+
+	if (hdr->image_size != size || hdr->n_sections > VENDOR_IMAGE_MAX_SECTIONS ||
+	    (!trusted && fnv1a64((const unsigned char *) base + sizeof(*hdr), size - sizeof(*hdr)) != hdr->checksum)) {
+		vendor_error("%s: corrupted vendor image", name);
+		return -EVENDORIMAGE;
+	}
+
+	entries = image_section(hdr, VIS_ENTRIES, sizeof(struct mac_vendor), &n_entries);
+	names   = image_section(hdr, VIS_NAMES, sizeof(struct vendor_name), &n_names_);
+	strings = image_section(hdr, VIS_STRINGS, 1, &n_strings);
+	dir     = image_section(hdr, VIS_TRIE_DIR, sizeof(uint32_t), &n_dir);
+	lo      = image_section(hdr, VIS_TRIE_LO, sizeof(uint8_t), &n_lo);
+	l24     = image_section(hdr, VIS_TRIE_L24, sizeof(struct trie_node), &n_l24);
+	l28     = image_section(hdr, VIS_TRIE_L28, sizeof(struct trie_node), &n_l28);
+	l36     = image_section(hdr, VIS_TRIE_L36, sizeof(uint32_t), &n_l36);
+	hash    = image_section(hdr, VIS_HASH, sizeof(struct hash_slot), &n_hash);
+	map     = image_section(hdr, VIS_OUI_MAP, sizeof(uint64_t), &n_map);
+	first   = image_section(hdr, VIS_NAME_FIRST, sizeof(uint32_t), &n_first);
+	by_name = image_section(hdr, VIS_NAME_ENTRIES, sizeof(uint32_t), &n_by_name);
+	tri     = image_section(hdr, VIS_TRIGRAMS, sizeof(struct trigram), &n_tri);
+	tri_names = image_section(hdr, VIS_TRIGRAM_NAMES, sizeof(uint32_t), &n_tri_names);
+	if (!entries || !names || !strings || n_strings == 0 || strings[n_strings - 1] != '\0' ||
+	    !dir || n_dir != TRIE_DIR_SIZE + 1 || !lo || !l24 || n_lo != n_l24 || !l28 || !l36 ||
+	    n_l28 % TRIE_L28_FANOUT || n_l36 % TRIE_L36_FANOUT ||
+	    !hash || n_hash == 0 || (n_hash & (n_hash - 1)) || !map || n_map != OUI_MAP_WORDS ||
+	    !first || n_first != n_names_ + 1 || !by_name || n_by_name != n_entries ||
+	    !tri || n_tri == 0 || !tri_names)
+		goto malformed;
+
+	if (trusted) {
+		n_keys = hdr->hash_keys;
+		max_psl = hdr->hash_max_psl;
+		goto checked;
+	}
+
+	/* the lookups trust every index, so check them once here */
+	for (uint32_t i = 0; i < n_entries; i++)
+		if (entries[i].mac >= n_strings || entries[i].name >= n_names_)
+			goto malformed;
+	for (uint32_t i = 0; i < n_names_; i++)
+		if (names[i].off >= n_strings || names[i].len >= n_strings - names[i].off ||
+		    strings[names[i].off + names[i].len] != '\0')
+			goto malformed;
+	for (uint32_t i = 0; i < n_dir; i++)
+		if (dir[i] > n_l24 || (i && dir[i] < dir[i - 1]))
+			goto malformed;
+	for (uint32_t i = 0; i < n_l24; i++)
+		if (l24[i].entry > n_entries || l24[i].child > n_l28 / TRIE_L28_FANOUT)
+			goto malformed;
+	for (uint32_t i = 0; i < n_l28; i++)
+		if (l28[i].entry > n_entries || l28[i].child > n_l36 / TRIE_L36_FANOUT)
+			goto malformed;
+	for (uint32_t i = 0; i < n_l36; i++)
+		if (l36[i] > n_entries)
+			goto malformed;
+	for (uint32_t i = 0; i < n_first; i++)
+		if (first[i] > n_by_name || (i && first[i] < first[i - 1]))
+			goto malformed;
+	for (uint32_t i = 0; i < n_by_name; i++)
+		if (by_name[i] >= n_entries)
+			goto malformed;
+	for (uint32_t i = 0; i < n_tri; i++)
+		if (tri[i].first > n_tri_names || (i && (tri[i].first < tri[i - 1].first || tri[i].key <= tri[i - 1].key)))
+			goto malformed;
+	if (tri[n_tri - 1].first != n_tri_names)
+		goto malformed;
+	for (uint32_t i = 0; i < n_tri_names; i++)
+		if (tri_names[i] >= n_names_)
+			goto malformed;
+	for (uint32_t i = 0; i < n_hash; i++) {
+		if (hash[i].entry > n_entries || hash[i].psl >= n_hash)
+			goto malformed;
+		if (hash[i].key) {
+			n_keys++;
+			if (hash[i].psl > max_psl)
+				max_psl = hash[i].psl;
+		}
+	}
+	if (n_keys != hdr->hash_keys || max_psl != hdr->hash_max_psl)
+		goto malformed;
+
+checked:
+	db->image        = (void *) base;
+	db->image_size   = size;
+	db->table        = (struct mac_vendor *) entries;
+	db->n_vendors    = db->max_vendors = n_entries;
+	db->names        = (struct vendor_name *) names;
+	db->n_names      = n_names_;
+	db->strings      = (char *) strings;
+	db->strings_size = db->max_strings = n_strings;
+
+	db->hash         = (struct hash_slot *) hash;
+	db->oui_map      = (uint64_t *) map;
+	db->hash_mask    = n_hash - 1;
+	db->n_hash_keys  = n_keys;
+	db->hash_max_psl = max_psl;
+
+	db->trie_dir   = (uint32_t *) dir;
+	db->trie_lo    = (uint8_t *) lo;
+	db->trie_l24   = (struct trie_node *) l24;
+	db->trie_l28   = (struct trie_node *) l28;
+	db->trie_l36   = (uint32_t *) l36;
+	db->n_trie_l24 = n_l24;
+	db->n_trie_l28 = n_l28 / TRIE_L28_FANOUT;
+	db->n_trie_l36 = n_l36 / TRIE_L36_FANOUT;
+
+	db->name_first    = (uint32_t *) first;
+	db->name_entries  = (uint32_t *) by_name;
+	db->trigrams      = (struct trigram *) tri;
+	db->trigram_names = (uint32_t *) tri_names;
+	db->n_trigrams    = n_tri - 1;
+
+	return db->n_vendors;
+
+malformed:
+	vendor_error("%s: malformed vendor image", name);
+	return -EVENDORIMAGE;
+}
+
+/* Maps the image file at path and checks all of it. The mapping is shared
+   and read-only, so every process using the same file shares the page cache
+   copy. */
+
+static int vendor_map_image(struct vendor_db *db, int fd, const char *path)
+{
+	struct stat st;
+	void *base;
+	int ret;
+
+	if (fstat(fd, &st) == -1) {
+		vendor_error("fstat: %s", strerror(errno));
+		return -1;
+	}
+
+	if (st.st_size < (off_t) sizeof(struct vendor_image_header)) {
+		vendor_error("%s: truncated vendor image", path);
+		return -EVENDORIMAGE;
+	}
+
+	base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (base == MAP_FAILED) {
+		vendor_error("mmap: %s", strerror(errno));
+		return -1;
+	}
+
+	if ((ret = vendor_use_image(db, base, st.st_size, path, 0)) < 0)
+		munmap(base, st.st_size);
+	return ret;
+}
+
 /*
-		if (strcmp (get_vendor_by_mac(mac), get_vendor_by_mac_binary(mac)) != 0) {
-			err ++;
-			printf("Error: ind=%d mac='%s' vendor1='%s' vendor2='%s'\n", i, mac,
-					get_vendor_by_mac(mac), get_vendor_by_mac_binary(mac));
+ * Readers and grace periods
+ *
+ * A thread that looks vendors up while the table may be replaced registers
+ * itself and calls vendor_quiescent() whenever it holds no vendor names, e.g.
+ * once per UI frame. A table that has been replaced is unmapped once every
+ * registered reader has been quiescent since; the writer sleeps for that, the
+ * readers never wait for anything. Threads that never register are fine as
+ * long as nothing replaces the table under them.
+ */
+
+#define VENDOR_MAX_READERS	64
+#define VENDOR_READER_OFFLINE	UINT64_MAX
+
+struct vendor_reader {
+	_Atomic int in_use;
+	_Atomic uint64_t seen;	/* the last grace period it was quiescent in */
+} __attribute((aligned(64)));
+
+static struct vendor_reader vendor_readers[VENDOR_MAX_READERS];
+static _Atomic uint64_t vendor_grace = 1;
+static __thread struct vendor_reader *vendor_self = NULL;
+
+int vendor_reader_register(void)
+{
+	if (vendor_self)
+		return 0;
+
+	for (int i = 0; i < VENDOR_MAX_READERS; i++) {
+		int unused = 0;
+
+		if (atomic_compare_exchange_strong(&vendor_readers[i].in_use, &unused, 1)) {
+			atomic_store(&vendor_readers[i].seen, atomic_load(&vendor_grace));
+			vendor_self = &vendor_readers[i];
+			return 0;
 		}
-*/
 	}
 
-	printf ("done.\nHaving found %d errors.\n", err);
-	printf ("Duration = %lld\n", time_nanoseconds() - ts2);
+	return -1;
+}
+
+void vendor_reader_unregister(void)
+{
+	if (!vendor_self)
+		return;
 
-	printf("Starting get_vendor_by_mac_binary_ulmac() full mac test ... ");
-	fflush(stdout);
+	atomic_store(&vendor_self->seen, VENDOR_READER_OFFLINE);
+	atomic_store(&vendor_self->in_use, 0);
+	vendor_self = NULL;
+}
 
-	err = 0;
-	ts2 = time_nanoseconds();
+void vendor_quiescent(void)
+{
+	if (vendor_self)
+		atomic_store(&vendor_self->seen, atomic_load(&vendor_grace));
+}
 
-	for (int i = 0; i < n; i++) {
-		
-		strcpy(mac, long_mac);
-		strcpy(mac, vendorTable[i].mac);
+/* Before a registered thread waits for a writer, which may in turn be waiting
+   for it to be quiescent; it holds no names while it waits, and is back with
+   vendor_quiescent(). */
 
-		char *vendor = get_vendor_by_mac_binary_ulmac(mac);
-		// `printf("%d of %ld: mac='%s' vendor='%s'\r", i, n, mac, vendor = hashtable_get_vendor_by_mac(mac));
-		// fflush(stdout);
-		if (strcmp(vendor, vendorTable[i].vendor) != 0) {
-			fprintf(stderr, "%d: '%s' -> '%s' != '%s' -> '%s'!\n", i,
-								get_mac_by_vendor(vendor),
-								vendor,
-								vendorTable[i].mac,
-								vendorTable[i].vendor);
-			err ++;
+static void vendor_reader_offline(void)
+{
+	if (vendor_self)
+		atomic_store(&vendor_self->seen, VENDOR_READER_OFFLINE);
+}
+
+/* Waits until every registered reader, other than the caller, has been
+   quiescent since the table was swapped. */
+
+static void vendor_synchronize(void)
+{
+	uint64_t grace = atomic_fetch_add(&vendor_grace, 1) + 1;
+	struct timespec tick = { 0, 1000000 };
+
+	for (int i = 0; i < VENDOR_MAX_READERS; i++) {
+		struct vendor_reader *r = &vendor_readers[i];
+
+		if (r == vendor_self)
+			continue;
+		while (atomic_load(&r->in_use) && atomic_load(&r->seen) < grace)
+			nanosleep(&tick, NULL);
+	}
+}
+
+/* Write the loaded (sorted) vendor table as an image for vendor_initialise().
+   The image is written next to path and renamed over it, so that readers
+   never see a half-written file. */
+
+int vendor_write_image(const char *path)
+{
+	struct vendor_image_header hdr;
+	size_t tmp_len = strlen(path) + sizeof(".tmp");
+	const struct vendor_db *db;
+	const unsigned char *image;
+	char *tmp_path = NULL;
+	int fd, ret = -1;
+	ssize_t n;
+
+	/* no reload may unmap the table while it is being written out */
+	vendor_reader_offline();
+	pthread_mutex_lock(&vendor_update_lock);
+	db = vendor_db_current();
+
+	if (db == NULL || db->n_vendors == 0) {
+		vendor_error("Must call vendor_initialise() first!");
+		goto out;
+	}
+
+	/* the table already is an image; a mapped one may be read-only, so the
+	   checksum goes into a copy of the header */
+	image = (const unsigned char *) db->image;
+	memcpy(&hdr, image, sizeof(hdr));
+	hdr.checksum = fnv1a64(image + sizeof(hdr), hdr.image_size - sizeof(hdr));
+
+	if ((tmp_path = (char *) malloc (tmp_len)) == NULL) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	snprintf(tmp_path, tmp_len, "%s.tmp", path);
+
+	if ((fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1) {
+		vendor_error("%s: %s", tmp_path, strerror(errno));
+		goto out;
+	}
+
+	for (uint64_t done = 0; done < hdr.image_size; done += n)
+		if ((n = done < sizeof(hdr) ? write(fd, (const char *) &hdr + done, sizeof(hdr) - done)
+					    : write(fd, image + done, hdr.image_size - done)) <= 0) {
+			vendor_error("write: %s", strerror(errno));
+			close(fd);
+			unlink(tmp_path);
+			goto out;
+		}
+
+	if (close(fd) == -1 || rename(tmp_path, path) == -1) {
+		vendor_error("%s: %s", path, strerror(errno));
+		unlink(tmp_path);
+		goto out;
+	}
+
+	ret = 0;
+out:
+	pthread_mutex_unlock(&vendor_update_lock);
+	vendor_quiescent();
+	free(tmp_path);
+	return ret;
+}
+
+static int oui_map_build(struct vendor_db *db, struct vendor_arena *a)
+{
+	db->oui_map = (uint64_t *) arena_section(a, VIS_OUI_MAP, sizeof(uint64_t), OUI_MAP_WORDS);
+	if (!db->oui_map)
+		return -ENOMEM;
+
+	for (size_t i = 0; i < db->n_vendors; i++) {
+		uint32_t oui = VT_PREFIX(db, i) >> 24;
+
+		db->oui_map[oui >> 6] |= 1ULL << (oui & 63);
+	}
+
+	return 0;
+}
+
+/* Unmaps the image or arena of a table that nobody uses any more. */
+
+static void vendor_db_free(struct vendor_db *db)
+{
+	if (db->image && !db->image_borrowed)
+		munmap(db->image, db->image_size);
+	free(db);
+}
+
+/* Copies the sorted table out of the loader's scratch arena into an arena of
+   its own, laid out exactly as an image, and builds the lookups there. The
+   scratch arena is unmapped as soon as it has been copied, to keep the peak
+   RSS down. */
+
+static int vendor_build_image(struct vendor_db *db, struct vendor_arena *scratch)
+{
+	struct vendor_arena a;
+	struct vendor_image_header *hdr;
+	struct mac_vendor *entries;
+	struct vendor_name *names;
+	char *strings;
+	uint32_t n24, n28, n36;
+	size_t size, n_trigrams = trigram_count(db);
+
+	trie_count(db, &n24, &n28, &n36);
+
+	size = IMAGE_ALIGN(sizeof(struct vendor_image_header)) +
+	       IMAGE_ALIGN(db->n_vendors * sizeof(struct mac_vendor)) +
+	       IMAGE_ALIGN(db->n_names * sizeof(struct vendor_name)) +
+	       IMAGE_ALIGN(db->strings_size) +
+	       IMAGE_ALIGN((TRIE_DIR_SIZE + 1) * sizeof(uint32_t)) +
+	       IMAGE_ALIGN(n24 * sizeof(uint8_t)) +
+	       IMAGE_ALIGN(n24 * sizeof(struct trie_node)) +
+	       IMAGE_ALIGN((size_t) n28 * TRIE_L28_FANOUT * sizeof(struct trie_node)) +
+	       IMAGE_ALIGN((size_t) n36 * TRIE_L36_FANOUT * sizeof(uint32_t)) +
+	       IMAGE_ALIGN(hash_slots(db->n_vendors, n28) * sizeof(struct hash_slot)) +
+	       IMAGE_ALIGN(OUI_MAP_WORDS * sizeof(uint64_t)) +
+	       IMAGE_ALIGN((db->n_names + 1) * sizeof(uint32_t)) +
+	       IMAGE_ALIGN(db->n_vendors * sizeof(uint32_t)) +
+	       IMAGE_ALIGN((n_trigrams + 1) * sizeof(struct trigram)) +
+	       IMAGE_ALIGN(n_trigrams * sizeof(uint32_t));
+
+	if (arena_map(&a, size) < 0) {
+		arena_unmap(scratch);
+		return -ENOMEM;
+	}
+
+	hdr = (struct vendor_image_header *) arena_alloc(&a, sizeof(struct vendor_image_header));
+	memcpy(hdr->magic, VENDOR_IMAGE_MAGIC, sizeof(VENDOR_IMAGE_MAGIC));
+	hdr->version    = VENDOR_IMAGE_VERSION;
+	hdr->byte_order = VENDOR_IMAGE_BYTE_ORDER;
+
+	entries = (struct mac_vendor *) arena_section(&a, VIS_ENTRIES, sizeof(struct mac_vendor), db->n_vendors);
+	names   = (struct vendor_name *) arena_section(&a, VIS_NAMES, sizeof(struct vendor_name), db->n_names);
+	strings = (char *) arena_section(&a, VIS_STRINGS, 1, db->strings_size);
+	if (!entries || !names || !strings) {
+		arena_unmap(scratch);
+		goto nomem;
+	}
+
+	db->table       = (struct mac_vendor *) memcpy(entries, db->table, db->n_vendors * sizeof(struct mac_vendor));
+	db->names       = (struct vendor_name *) memcpy(names, db->names, db->n_names * sizeof(struct vendor_name));
+	db->strings     = (char *) memcpy(strings, db->strings, db->strings_size);
+	db->max_vendors = db->n_vendors;
+	db->max_strings = db->strings_size;
+	arena_unmap(scratch);
+
+	if (trie_build(db, &a) < 0 || hash_build(db, &a) < 0 || oui_map_build(db, &a) < 0 ||
+	    name_index_build(db, &a) < 0 || trigram_build(db, &a) < 0)
+		goto nomem;
+	hdr->hash_keys    = db->n_hash_keys;
+	hdr->hash_max_psl = db->hash_max_psl;
+
+	db->image      = a.base;
+	db->image_size = a.size;
+	return 0;
+
+nomem:
+	arena_unmap(&a);
+	return -ENOMEM;
+}
+
+/* Loads the CSV or image at mac_vendor_list into db, which is not published
+   yet, so nothing else can see it half built. Returns the number of entries
+   or a negative error, in which case db holds nothing. */
+
+static int vendor_db_load(struct vendor_db *db, const char *mac_vendor_list)
+{
+	FILE  *fvendor;
+	size_t n = 200;
+	char *line;
+	struct vendor_arena scratch;
+	struct stat st;
+	struct csv_line *csv_lines;
+	size_t max_lines, max_intern;
+	uint64_t t = vendor_clock_ns();
+	int ret = 0;
+
+	if ((fvendor = fopen(mac_vendor_list, "r")) == NULL) {
+		vendor_error("%s: %s", mac_vendor_list, strerror(errno));
+		return -1;
+	}
+
+	if (is_vendor_image(fvendor)) {
+		ret = vendor_map_image(db, fileno(fvendor), mac_vendor_list);
+		fclose(fvendor);
+		db->build_ns[VENDOR_PHASE_READ] = vendor_clock_ns() - t;
+		return ret;
+	}
+
+	if (fstat(fileno(fvendor), &st) == -1) {
+		vendor_error("fstat: %s", strerror(errno));
+		fclose(fvendor);
+		return -1;
+	}
+
+	/* A line is at least a 6 digit prefix, three commas and a newline, and
+	   its strings never take more room in the pool than the line itself, so
+	   the file size bounds everything; what is not used is never touched. */
+	max_lines = st.st_size / 9 + 1;
+	for (max_intern = NAME_INTERN_INIT; max_intern < 2 * max_lines; max_intern *= 2);
+
+	if (arena_map(&scratch, IMAGE_ALIGN(max_lines * sizeof(struct mac_vendor)) +
+				IMAGE_ALIGN(max_lines * sizeof(struct vendor_name)) +
+				IMAGE_ALIGN(st.st_size + 1) +
+				2 * IMAGE_ALIGN(max_intern * sizeof(uint32_t)) +
+				IMAGE_ALIGN(2 * (max_lines + CSV_MAX_THREADS) * sizeof(struct csv_line))) < 0) {
+		fclose(fvendor);
+		return -ENOMEM;
+	}
+
+	db->table       = (struct mac_vendor *) arena_alloc(&scratch, max_lines * sizeof(struct mac_vendor));
+	db->names       = (struct vendor_name *) arena_alloc(&scratch, max_lines * sizeof(struct vendor_name));
+	db->strings     = (char *) arena_alloc(&scratch, st.st_size + 1);
+	csv_lines       = (struct csv_line *) arena_alloc(&scratch, 2 * (max_lines + CSV_MAX_THREADS) * sizeof(struct csv_line));
+	db->max_vendors = max_lines;
+	db->max_strings = st.st_size + 1;
+	db->name_intern_arena = &scratch;
+	db->build_ns[VENDOR_PHASE_READ] = vendor_clock_ns() - t;
+
+	if (S_ISREG(st.st_mode) && st.st_size > 0 &&
+	    (ret = vendor_load_csv_mmap(db, fileno(fvendor), st.st_size, csv_lines, max_lines + CSV_MAX_THREADS)) != -1) {
+		if (ret < 0)
+			goto fail;
+	} else if ((line = (char *) malloc(n)) != NULL) {
+		ssize_t len;
+
+		ret = getline(&line, &n, fvendor);
+
+		while ((len = getline(&line, &n, fvendor)) != -1) {
+			struct csv_line l;
+
+			if (len && line[len - 1] == '\n')
+				len--;
+			if (csv_parse_line(line, line + len, line, &l) < 0 || vendor_add_line(db, &l, line) < 0) {
+				vendor_error("MAC: format error in line %zu", db->n_vendors + 1);
+				free(line);
+				goto fail;
+			}
 		}
+
+		if (ferror(fvendor))
+			vendor_error("getline: %s", strerror(errno));
+		free(line);
+		db->build_ns[VENDOR_PHASE_PARSE] = vendor_clock_ns() - t - db->build_ns[VENDOR_PHASE_READ];
+
+		t = vendor_clock_ns();
+		radix_sort(db->table, db->n_vendors, sizeof(struct mac_vendor), csv_lines);
+		db->build_ns[VENDOR_PHASE_SORT] = vendor_clock_ns() - t;
+	} else
+		goto fail;
+
+	fclose(fvendor);
+	db->name_intern = NULL;
+	db->name_intern_mask = 0;
+	db->name_intern_arena = NULL;
+	t = vendor_clock_ns();
+	if ((ret = vendor_build_image(db, &scratch)) < 0) {
+		memset(db, 0, sizeof(*db));
+		return ret;
+	}
+	db->build_ns[VENDOR_PHASE_INDEX] = vendor_clock_ns() - t;
+
+	return db->n_vendors;
+
+fail:
+	arena_unmap(&scratch);
+	memset(db, 0, sizeof(*db));
+	fclose(fvendor);
+	return -EVENDORFORMAT;
+}
+
+/* Makes db (NULL for none) the table the lookups use, and frees the one it
+   replaces once no reader can hold a pointer into it. */
+
+static void vendor_publish(struct vendor_db *db)
+{
+	struct vendor_db *old;
+
+	vendor_reader_offline();
+	pthread_mutex_lock(&vendor_update_lock);
+	if (db)
+		db->generation = ++vendor_generation_count;
+	old = atomic_exchange(&vendor_current, db);
+	atomic_store(&vendor_published, db ? db->generation : 0);
+	if (old) {
+		vendor_synchronize();
+		vendor_db_free(old);
+	}
+	pthread_mutex_unlock(&vendor_update_lock);
+	vendor_quiescent();
+}
+
+/* A table of one's own, which nothing but the caller ever publishes, replaces
+   or frees. */
+
+struct vendor_db *vendor_db_open(const char *path)
+{
+	struct vendor_db *db = (struct vendor_db *) calloc(1, sizeof(struct vendor_db));
+
+	if (!db)
+		return NULL;
+
+	if (vendor_db_load(db, path) < 0) {
+		free(db);
+		return NULL;
+	}
+
+	return db;
+}
+
+struct vendor_db *vendor_db_open_image(const void *image, size_t size)
+{
+	struct vendor_db *db = (struct vendor_db *) calloc(1, sizeof(struct vendor_db));
+	uint64_t t = vendor_clock_ns();
+
+	if (!db)
+		return NULL;
+
+	if (vendor_use_image(db, image, size, "built-in vendor image", 1) < 0) {
+		free(db);
+		return NULL;
+	}
+	db->image_borrowed = 1;
+	db->build_ns[VENDOR_PHASE_READ] = vendor_clock_ns() - t;
+
+	return db;
+}
+
+void vendor_db_close(struct vendor_db *db)
+{
+	if (db)
+		vendor_db_free(db);
+}
+
+void vendor_count_lookups(int on)
+{
+	atomic_store(&vendor_counting, on);
+}
+
+int vendor_db_stats(const struct vendor_db *db, struct vendor_db_stats *st)
+{
+	const struct vendor_image_header *hdr;
+	uint32_t *psl;
+	uint64_t n;
+
+	memset(st, 0, sizeof(*st));
+	if (!db)
+		return -1;
+
+	st->entries = db->n_vendors;
+	st->names = db->n_names;
+	for (size_t i = 0; i < db->n_vendors; i++)
+		st->entries_by_type[VT_BITS(db, i) == 24 ? 0 : VT_BITS(db, i) == 28 ? 1 : 2]++;
+
+	hdr = (const struct vendor_image_header *) db->image;
+	st->bytes_image = hdr->image_size;
+	for (uint32_t i = 0; i < hdr->n_sections; i++) {
+		size_t size = hdr->section[i].size;
+
+		switch (hdr->section[i].id) {
+		case VIS_ENTRIES:	st->bytes_entries += size; break;
+		case VIS_NAMES:		st->bytes_names += size; break;
+		case VIS_STRINGS:	st->bytes_strings += size; break;
+		case VIS_TRIE_DIR:
+		case VIS_TRIE_LO:
+		case VIS_TRIE_L24:
+		case VIS_TRIE_L28:
+		case VIS_TRIE_L36:	st->bytes_trie += size; break;
+		case VIS_HASH:		st->bytes_hash += size; break;
+		case VIS_OUI_MAP:	st->bytes_oui_map += size; break;
+		case VIS_NAME_FIRST:
+		case VIS_NAME_ENTRIES:	st->bytes_name_index += size; break;
+		case VIS_TRIGRAMS:
+		case VIS_TRIGRAM_NAMES:	st->bytes_trigrams += size; break;
+		}
+	}
+
+	st->hash_slots = db->hash_mask + 1;
+	st->hash_keys = db->n_hash_keys;
+	st->psl_max = db->hash_max_psl;
+	if ((psl = (uint32_t *) calloc(db->hash_max_psl + 1, sizeof(uint32_t))) != NULL) {
+		for (uint32_t i = 0; i <= db->hash_mask; i++)
+			if (db->hash[i].key)
+				psl[db->hash[i].psl]++;
+		/* the p-th percentile is the least length that p% of the keys do not exceed */
+		n = 0;
+		for (uint32_t i = 0; i <= db->hash_max_psl; i++) {
+			uint64_t below = n * 100, keys = db->n_hash_keys;
+
+			st->psl_histogram[i < VENDOR_PSL_HISTOGRAM ? i : VENDOR_PSL_HISTOGRAM - 1] += psl[i];
+			n += psl[i];
+			if (below < keys * 50 && n * 100 >= keys * 50)
+				st->psl_p50 = i;
+			if (below < keys * 90 && n * 100 >= keys * 90)
+				st->psl_p90 = i;
+			if (below < keys * 99 && n * 100 >= keys * 99)
+				st->psl_p99 = i;
+		}
+		free(psl);
+	}
+
+	st->trie_l24_nodes = db->n_trie_l24;
+	st->trie_l28_blocks = db->n_trie_l28;
+	st->trie_l36_blocks = db->n_trie_l36;
+	st->trigrams = db->n_trigrams;
+	st->trigram_postings = db->trigrams ? db->trigrams[db->n_trigrams].first : 0;
+
+	memcpy(st->build_ns, db->build_ns, sizeof(st->build_ns));
+	st->lookups = atomic_load_explicit(&db->counters.lookups, memory_order_relaxed);
+	st->hits = atomic_load_explicit(&db->counters.hits, memory_order_relaxed);
+
+	return 0;
+}
+
+uint64_t vendor_generation(void)
+{
+	return atomic_load(&vendor_published);
+}
+
+int vendor_initialise(const char *mac_vendor_list)
+{
+	struct vendor_db *db = (struct vendor_db *) calloc(1, sizeof(struct vendor_db));
+	int ret;
+
+	if (!db)
+		return -ENOMEM;
+
+	if ((ret = vendor_db_load(db, mac_vendor_list)) < 0) {
+		free(db);
+		return ret;
+	}
+
+	vendor_publish(db);
+	return ret;
+}
+
+int vendor_initialise_image(const void *image, size_t size)
+{
+	struct vendor_db *db = vendor_db_open_image(image, size);
+	int n;
+
+	if (!db)
+		return -EVENDORIMAGE;
+
+	n = db->n_vendors;
+	vendor_publish(db);
+	return n;
+}
+
 /*
-		if (strcmp (get_vendor_by_mac(mac), get_vendor_by_mac_binary(mac)) != 0) {
-			err ++;
-			printf("Error: ind=%d mac='%s' vendor1='%s' vendor2='%s'\n", i, mac,
-					get_vendor_by_mac(mac), get_vendor_by_mac_binary(mac));
+ * Watching the file
+ *
+ * vendor_watch() starts a thread that waits for inotify to report the file
+ * rewritten or renamed into place, lets it settle, loads it on the side and
+ * publishes it. The directory is watched rather than the file, so that a
+ * replaced file is noticed too. A file that does not load leaves the table
+ * as it was.
+ */
+
+#define VENDOR_WATCH_SETTLE_MS	250	/* quiet time before a changed file is loaded */
+
+static struct {
+	pthread_t thread;
+	int running;
+	int inotify_fd;
+	int stop[2];		/* a pipe: writing to it stops the thread */
+	char *path;
+	const char *name;	/* the last component of path */
+} vendor_watcher;
+
+/* Returns 1 if the file changed within timeout ms (-1 for no limit), 0 if
+   not, and -1 when the thread is to stop. */
+
+static int vendor_watch_wait(int timeout)
+{
+	struct pollfd pfd[2] = { { vendor_watcher.inotify_fd, POLLIN, 0 }, { vendor_watcher.stop[0], POLLIN, 0 } };
+	char buf[4096] __attribute((aligned(__alignof__(struct inotify_event))));
+	const struct inotify_event *ev;
+	int changed = 0;
+	ssize_t len;
+
+	if (poll(pfd, 2, timeout) <= 0)
+		return 0;
+	if (pfd[1].revents)
+		return -1;
+	if ((len = read(vendor_watcher.inotify_fd, buf, sizeof(buf))) <= 0)
+		return 0;
+
+	for (char *p = buf; p < buf + len; p += sizeof(struct inotify_event) + ev->len) {
+		ev = (const struct inotify_event *) p;
+		if (ev->len && strcmp(ev->name, vendor_watcher.name) == 0)
+			changed = 1;
+	}
+
+	return changed;
+}
+
+static void *vendor_watch_thread(void *arg)
+{
+	int changed;
+
+	/* errors go to vendor_reload_stats(), not over the screen of the UI */
+	vendor_quiet = 1;
+
+	while ((changed = vendor_watch_wait(-1)) >= 0) {
+		struct vendor_db *db;
+		int ret;
+
+		if (!changed)
+			continue;
+		while ((changed = vendor_watch_wait(VENDOR_WATCH_SETTLE_MS)) > 0);
+		if (changed < 0)
+			break;
+
+		if ((db = (struct vendor_db *) calloc(1, sizeof(struct vendor_db))) == NULL)
+			ret = -ENOMEM, vendor_error("%s: out of memory", vendor_watcher.path);
+		else if ((ret = vendor_db_load(db, vendor_watcher.path)) == 0)
+			vendor_error("%s: no vendors", vendor_watcher.path);
+
+		pthread_mutex_lock(&vendor_stats_lock);
+		if (ret > 0)
+			vendor_reloads++;
+		else {
+			vendor_reload_failures++;
+			strcpy(vendor_reload_error, vendor_errbuf);
 		}
-*/
+		pthread_mutex_unlock(&vendor_stats_lock);
+
+		/* an empty table still has its image mapped, the failures do not */
+		if (ret > 0)
+			vendor_publish(db);
+		else if (ret == 0)
+			vendor_db_free(db);
+		else
+			free(db);
 	}
 
-	printf ("done.\nHaving found %d errors.\n", err);
-	printf ("Duration = %lld\n", time_nanoseconds() - ts2);
+	return NULL;
+}
+
+void vendor_reload_stats(struct vendor_reload_stats *st)
+{
+	pthread_mutex_lock(&vendor_stats_lock);
+	st->generation = vendor_generation();
+	st->reloads = vendor_reloads;
+	st->failures = vendor_reload_failures;
+	strcpy(st->last_error, vendor_reload_error);
+	pthread_mutex_unlock(&vendor_stats_lock);
+}
 
+void vendor_unwatch(void)
+{
+	if (!vendor_watcher.running)
+		return;
+
+	vendor_reader_offline();
+	if (write(vendor_watcher.stop[1], "", 1) == 1)
+		pthread_join(vendor_watcher.thread, NULL);
+	vendor_quiescent();
+	close(vendor_watcher.stop[0]);
+	close(vendor_watcher.stop[1]);
+	close(vendor_watcher.inotify_fd);
+	free(vendor_watcher.path);
+	vendor_watcher.running = 0;
 }
 
-#endif /* DEVELOP_MAC_TABLE */
+int vendor_watch(const char *path)
+{
+	const char *slash = strrchr(path, '/');
+	char *dir;
+	int ret;
+
+	vendor_unwatch();
 
+	if (!(vendor_watcher.path = strdup(path)))
+		return -ENOMEM;
+	vendor_watcher.name = slash ? vendor_watcher.path + (slash - path) + 1 : vendor_watcher.path;
+
+	if (!slash)
+		dir = strdup(".");
+	else
+		dir = strndup(path, slash == path ? 1 : slash - path);
+	if (!dir) {
+		free(vendor_watcher.path);
+		return -ENOMEM;
+	}
+
+	if ((vendor_watcher.inotify_fd = inotify_init1(IN_CLOEXEC)) == -1) {
+		vendor_error("inotify_init1: %s", strerror(errno));
+		goto out;
+	}
+	if (inotify_add_watch(vendor_watcher.inotify_fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO) == -1) {
+		vendor_error("%s: %s", dir, strerror(errno));
+		close(vendor_watcher.inotify_fd);
+		goto out;
+	}
+	if (pipe(vendor_watcher.stop) == -1) {
+		vendor_error("pipe: %s", strerror(errno));
+		close(vendor_watcher.inotify_fd);
+		goto out;
+	}
+	if ((ret = pthread_create(&vendor_watcher.thread, NULL, vendor_watch_thread, NULL)) != 0) {
+		vendor_error("pthread_create: %s", strerror(ret));
+		close(vendor_watcher.stop[0]);
+		close(vendor_watcher.stop[1]);
+		close(vendor_watcher.inotify_fd);
+		goto out;
+	}
+
+	vendor_watcher.running = 1;
+	free(dir);
+	return 0;
+
+out:
+	free(dir);
+	free(vendor_watcher.path);
+	return -1;
+}
+
+/* Stops watching and frees the table, once no reader can be using it. */
+
+void vendor_release(void)
+{
+	vendor_unwatch();
+	vendor_publish(NULL);
+}
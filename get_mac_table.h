@@ -7,19 +7,207 @@
 #ifndef __GET_MAC_TABLE_H
 #define __GET_MAC_TABLE_H
 
-#define NO_BUCKETS (2 << 12)
 #define SWAPXY(X,Y) ({ __typeof(X) tmp = (X); (X) = (Y); (Y) = tmp; })
 #define ROTL32(X,D) ((X) << (D) | (X) >> (32 - (D)) & 0xffffffff)
 
+#include <stddef.h>
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-extern char *get_vendor_by_mac (const char *mac);
-extern char *get_vendor_by_mac_hashtable (const char *mac);
-extern char *get_vendor_by_mac_binary (const char *mac);
+struct vendor_db;
+
+/* The string engines. get_vendor_by_mac() is a linear scan, the two binary
+   searches match strings and may return a near miss or "Unknown" for a MAC
+   without a vendor; they are kept for comparison (see mac-table-bench).
+   These and get_vendor_by_mac_trie() take the MAC in any notation
+   mac_parse() below knows, in either case. */
+extern const char *get_vendor_by_mac (const char *mac);
+extern const char *get_vendor_by_mac_hashtable (const char *mac);
+extern const char *get_vendor_by_mac_binary (const char *mac);
+extern const char *get_vendor_by_mac_binary_ulmac (const char *mac);
+
+/* Longest prefix match (MA-L/MA-M/MA-S) on the MAC as a 48-bit integer,
+   in a bounded number of memory accesses. Accepts either case. A MAC that
+   matches no assignment is "Randomized/LAA" if it is a locally administered
+   unicast address and "Unassigned" otherwise; "Unknown" means there was
+   no table or no MAC. The hashtable and BSSID lookups answer the same. */
+extern const char *get_vendor_by_mac_trie (const char *mac);
+
+/* As above, but straight from the 6 raw BSSID bytes: never allocates and never
+   formats or parses strings. If len is not NULL, the length of the returned
+   vendor name is stored there. */
+extern const char *get_vendor_by_bssid (const uint8_t bssid[6], size_t *len);
+
+/* Resolves n MACs at once, overlapping their memory accesses. The i-th MAC is
+   the 6 bytes at macs + i * stride, so an array of any struct holding a BSSID
+   can be passed directly; the names (and lengths, if lens is not NULL) are
+   stored in vendors[i]. Returns the number of MACs with a known vendor. */
+extern size_t get_vendors_by_macs (const uint8_t *macs, size_t stride, size_t n, const char **vendors, size_t *lens);
+
+/* the same for a struct bss_info array from wifi_scan_all() */
+#define get_vendors_by_bss_info(BSS, N, VENDORS, LENS) \
+	get_vendors_by_macs((BSS)->bssid, sizeof(*(BSS)), (N), (VENDORS), (LENS))
+
+/* Parses the MAC at the start of s, of len characters, in any of the usual
+   notations and either case: aa:bb:cc:dd:ee:ff, aa-bb-cc-dd-ee-ff,
+   aabb.ccdd.eeff or aabbccddeeff. Returns the number of characters it
+   took, or 0 if s does not start with a MAC. mac_find() returns the first
+   MAC in s, or NULL, and stores its length in *mac_len if not NULL. */
+extern size_t mac_parse(const char *s, size_t len, uint8_t mac[6]);
+extern const char *mac_find(const char *s, size_t len, uint8_t mac[6], size_t *mac_len);
+
+/*
+ * Handles
+ *
+ * A struct vendor_db is one loaded table. Lookups only ever read it, so any
+ * number of threads can share one without locking. The vendor_db_lookup*()
+ * functions take several tables in priority order, e.g. a site-local list
+ * ahead of the upstream one: the first table that has the MAC assigned
+ * answers, and the MAC is "Unassigned" (or "Randomized/LAA") only if none of
+ * them does. With n_dbs == 0 the answer is "Unknown". The functions above
+ * are these with the table vendor_initialise() published.
+ */
+
+/* Loads a table (CSV or image) that is the caller's alone: it is neither
+   watched nor replaced, and must outlive every lookup in it. Returns NULL
+   if the file does not load. */
+extern struct vendor_db *vendor_db_open(const char *path);
+extern void vendor_db_close(struct vendor_db *db);
+
+extern const char *vendor_db_lookup(const struct vendor_db *const *dbs, size_t n_dbs, const uint8_t bssid[6], size_t *len);
+extern const char *vendor_db_lookup_mac(const struct vendor_db *const *dbs, size_t n_dbs, const char *mac);
+extern size_t vendor_db_lookup_macs(const struct vendor_db *const *dbs, size_t n_dbs,
+				    const uint8_t *macs, size_t stride, size_t n, const char **vendors, size_t *lens);
+
+#define vendor_db_lookup_bss_info(DBS, N_DBS, BSS, N, VENDORS, LENS) \
+	vendor_db_lookup_macs((DBS), (N_DBS), (BSS)->bssid, sizeof(*(BSS)), (N), (VENDORS), (LENS))
+
+/* Names are numbered 0 .. n - 1 in each table. vendor_db_name_id() finds a
+   name exactly, vendor_db_search() every name containing pattern, ignoring
+   ASCII case, by way of a trigram index; it stores up to max ids and returns
+   how many there are. */
+extern const char *vendor_db_name(const struct vendor_db *db, uint32_t id, size_t *len);
+extern long vendor_db_name_id(const struct vendor_db *db, const char *vendor);
+extern size_t vendor_db_search(const struct vendor_db *db, const char *pattern, uint32_t *ids, size_t max);
+
+/* MAC48s from first to last, inclusive. */
+struct vendor_range {
+	uint64_t first, last;
+};
+
+/* The blocks assigned to a name, in prefix order. Stores up to max and
+   returns how many there are. */
+extern size_t vendor_db_name_prefixes(const struct vendor_db *db, uint32_t id, struct vendor_range *ranges, size_t max);
+
+/* Every MAC db resolves to a name containing pattern, as sorted, disjoint
+   ranges (blocks of other vendors nested in a matching one are cut out), for
+   vendor_ranges_match() to filter scan results with. Stores up to max and
+   returns how many there are. */
+extern size_t vendor_db_search_ranges(const struct vendor_db *db, const char *pattern, struct vendor_range *ranges, size_t max);
+extern int vendor_ranges_match(const struct vendor_range *ranges, size_t n, const uint8_t bssid[6]);
+
+/*
+ * Statistics
+ *
+ * What a table is made of, for sizing it and for the benchmark to check.
+ */
+
+enum vendor_phase {
+	VENDOR_PHASE_READ,	/* opening, mapping and checking the file */
+	VENDOR_PHASE_PARSE,	/* the CSV lines, and merging them into the table */
+	VENDOR_PHASE_SORT,
+	VENDOR_PHASE_INDEX,	/* the trie, hash table, bitmap and reverse index */
+	VENDOR_PHASES
+};
+
+#define VENDOR_PSL_HISTOGRAM	16
+
+struct vendor_db_stats {
+	size_t entries;			/* blocks: MA-L, MA-M and MA-S */
+	size_t entries_by_type[3];	/* 24, 28 and 36 bit blocks */
+	size_t names;			/* distinct vendors */
+
+	/* bytes per structure; bytes_image adds the header and the alignment */
+	size_t bytes_entries, bytes_names, bytes_strings, bytes_trie, bytes_hash,
+	       bytes_oui_map, bytes_name_index, bytes_trigrams, bytes_image;
+
+	uint32_t hash_slots, hash_keys;
+	uint32_t psl_histogram[VENDOR_PSL_HISTOGRAM];	/* keys by probe sequence length, the last one and up */
+	uint32_t psl_p50, psl_p90, psl_p99, psl_max;
+
+	uint32_t trie_l24_nodes, trie_l28_blocks, trie_l36_blocks;
+	uint32_t trigrams, trigram_postings;
+
+	uint64_t build_ns[VENDOR_PHASES];	/* an image is all read */
+
+	uint64_t lookups, hits;		/* MACs asked for and found, see vendor_count_lookups() */
+};
+
+/* Fills in st; returns -1 if there is no db. */
+extern int vendor_db_stats(const struct vendor_db *db, struct vendor_db_stats *st);
+
+/* Counting lookups costs an atomic add per table and lookup (per batch for
+   vendor_db_lookup_macs()), so it is off until turned on. */
+extern void vendor_count_lookups(int on);
+
+struct vendor_reload_stats {
+	uint64_t generation;		/* as vendor_generation() */
+	uint64_t reloads, failures;	/* by vendor_watch() */
+	char last_error[256];		/* why the last reload failed, "" if none did */
+};
+
+extern void vendor_reload_stats(struct vendor_reload_stats *st);
+
+/* The table vendor_initialise() published, NULL if none. A registered reader
+   may use it until its next vendor_quiescent(). */
+extern const struct vendor_db *vendor_db_current(void);
+
+/* Loads either the CSV export or a binary image written by vendor_write_image(),
+   which is recognised by its magic number and mmap()-ed read-only in place.
+   The new table replaces the current one atomically; if it fails to load, the
+   current one stays. Prints nothing but errors; returns the number of
+   entries. */
 extern int vendor_initialise(const char *mac_vendor_list);
 
+/* Uses an image already in memory in place, such as the one mac_vendors_db.S
+   builds into the program: nothing is read, copied or allocated but the
+   handle, and only the header and section table are checked, so it has to
+   come from mac-table-compile of the same build and stay where it is for as
+   long as the table is in use. */
+extern int vendor_initialise_image(const void *image, size_t size);
+extern struct vendor_db *vendor_db_open_image(const void *image, size_t size);
+
+/* The image mac_vendors_db.S embeds in .rodata, if mac_vendors_db.o is linked. */
+extern const unsigned char mac_vendors_db[], mac_vendors_db_end[];
+
+/* Reloads the table in the background whenever the file is rewritten or
+   renamed into place, until vendor_unwatch(). Returns 0 on success. */
+extern int vendor_watch(const char *mac_vendor_list);
+extern void vendor_unwatch(void);
+
+/* A thread that looks vendors up while the table may be replaced (see
+   vendor_watch()) registers once and calls vendor_quiescent() whenever it
+   holds no vendor names. Names it got stay valid until its next
+   vendor_quiescent(); lookups never block. */
+extern int vendor_reader_register(void);
+extern void vendor_reader_unregister(void);
+extern void vendor_quiescent(void);
+
+/* Counts the tables published: changes whenever the table has been replaced,
+   0 when there is none. */
+extern uint64_t vendor_generation(void);
+
+/* Writes the table loaded by vendor_initialise() as a versioned, checksummed
+   binary image (see mac-table-compile). Returns 0 on success. */
+extern int vendor_write_image(const char *path);
+
+/* Stops watching and frees everything vendor_initialise() loaded, in one
+   munmap() once no registered reader can be using it. */
+extern void vendor_release(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,709 @@
+/*
+ *
+ * Vendor lookup benchmark and differential test
+ *
+ * Usage: mac-table-bench [-n lookups] [-s seed] [-b bssids.txt] [-i mac-vendors.db]
+ *			  mac-vendors-export.csv
+ *
+ * Times every lookup engine on the same MACs, drawn from a fixed seed:
+ *
+ *   random	uniformly random 48-bit MACs (almost all of them unassigned)
+ *   assigned	random MACs inside a random assigned block
+ *   sequential	consecutive OUIs from a random start
+ *   unknown	random MACs that match no block
+ *   bssid	the MACs in bssids.txt (the first MAC on each line, e.g. from
+ *		iw dev wlan0 scan), or else a synthetic scan: a few dozen
+ *		access points seen over and over, a third of them randomized
+ *
+ * The clock is read around every batch of BENCH_BATCH lookups, and the
+ * percentiles are of the per-lookup time within a batch. Cache misses are
+ * counted with perf_event_open() where the kernel allows it.
+ *
+ * Every answer is checked against a reference built here from the CSV by
+ * plain binary search, so a regression is not mistaken for a speedup. The
+ * legacy engines are only expected to find the right vendor of assigned
+ * MACs; any mismatch of the others makes the exit status 1.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "get_mac_table.h"
+
+#define BENCH_BATCH	64
+#define BENCH_LOOKUPS	100000
+#define BENCH_LOADS	3	/* the load time is the best of these */
+#define BENCH_LINEAR	256 	/* get_vendor_by_mac() scans the whole table */
+#define BENCH_APS	48	/* access points in the synthetic scan */
+#define BENCH_SHOW	3	/* wrong answers printed per run */
+
+#define MAC48_LOCAL_BIT	(0x02ULL << 40)
+#define MAC48_GROUP_BIT	(0x01ULL << 40)
+
+static const char ref_unassigned[] = "Unassigned";
+static const char ref_local[] = "Randomized/LAA";
+
+/* The reference: one array per block size, sorted on the prefix */
+
+struct ref_entry {
+	uint64_t prefix;
+	size_t seq;		/* line number, the last of equal prefixes wins */
+	char *name;
+};
+
+static struct ref_entry *ref_table[3];
+static size_t ref_count[3];
+static const int ref_bits[3] = { 36, 28, 24 };
+
+struct workload {
+	const char *name;
+	size_t n;
+	uint64_t *mac48;
+	uint8_t (*bssid)[6];
+	char (*str)[18];
+	const char **want;
+};
+
+struct engine {
+	const char *name;
+	int legacy;		/* only assigned MACs must match */
+	size_t max_lookups;	/* 0 for all */
+	void (*run)(struct workload *w, size_t i, size_t n, const char **out);
+};
+
+static uint64_t rng_state;
+
+static uint64_t rng_next(void)
+{
+	/* xorshift64* */
+	rng_state ^= rng_state >> 12;
+	rng_state ^= rng_state << 25;
+	rng_state ^= rng_state >> 27;
+	return rng_state * 0x2545f4914f6cdd1dULL;
+}
+
+static unsigned long long time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static size_t rss_bytes(void)
+{
+	FILE *f = fopen("/proc/self/statm", "r");
+	unsigned long size, resident = 0;
+
+	if (f) {
+		if (fscanf(f, "%lu %lu", &size, &resident) != 2)
+			resident = 0;
+		fclose(f);
+	}
+
+	return resident * sysconf(_SC_PAGESIZE);
+}
+
+static int perf_open(void)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = PERF_COUNT_HW_CACHE_MISSES;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static int ref_compare(const void *a, const void *b)
+{
+	const struct ref_entry *x = a, *y = b;
+
+	if (x->prefix != y->prefix)
+		return x->prefix < y->prefix ? -1 : 1;
+	return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+static int ref_load(const char *path)
+{
+	FILE *f = fopen(path, "r");
+	size_t cap[3] = { 0 };
+	size_t lineno = 0;
+	char line[1024];
+
+	if (!f)
+		return -1;
+
+	while (fgets(line, sizeof(line), f)) {
+		uint64_t prefix = 0;
+		int digits = 0, k;
+		char *p, *name, *end;
+
+		if (lineno++ == 0)
+			continue;	/* header */
+
+		for (p = line; *p && *p != ','; p++) {
+			if (*p == ':')
+				continue;
+			if (!isxdigit((unsigned char) *p))
+				break;
+			prefix = prefix << 4 | (isdigit((unsigned char) *p) ? *p - '0' : (toupper(*p) - 'A' + 10));
+			digits++;
+		}
+		if (*p != ',')
+			continue;
+
+		name = p + 1;
+		if (*name == '"') {
+			name++;
+			end = strchr(name, '"');
+		} else
+			end = strpbrk(name, ",\r\n");
+		if (!end)
+			continue;
+		*end = '\0';
+
+		for (k = 0; k < 3 && ref_bits[k] != digits * 4; k++)
+			;
+		if (k == 3)
+			continue;
+
+		if (ref_count[k] == cap[k]) {
+			cap[k] = cap[k] ? cap[k] * 2 : 1024;
+			ref_table[k] = realloc(ref_table[k], cap[k] * sizeof(*ref_table[k]));
+			if (!ref_table[k]) {
+				fclose(f);
+				return -1;
+			}
+		}
+		ref_table[k][ref_count[k]].prefix = prefix << (48 - digits * 4);
+		ref_table[k][ref_count[k]].seq = lineno;
+		ref_table[k][ref_count[k]].name = strdup(name);
+		ref_count[k]++;
+	}
+	fclose(f);
+
+	for (int k = 0; k < 3; k++) {
+		size_t j = 0;
+
+		qsort(ref_table[k], ref_count[k], sizeof(*ref_table[k]), ref_compare);
+		for (size_t i = 0; i < ref_count[k]; i++) {
+			if (j && ref_table[k][j - 1].prefix == ref_table[k][i].prefix)
+				j--;
+			ref_table[k][j++] = ref_table[k][i];
+		}
+		ref_count[k] = j;
+	}
+
+	return ref_count[0] + ref_count[1] + ref_count[2];
+}
+
+static const char *ref_find(uint64_t mac48, int *assigned)
+{
+	if (assigned)
+		*assigned = 0;
+
+	for (int k = 0; k < 3; k++) {
+		uint64_t prefix = mac48 & (~0ULL << (48 - ref_bits[k])) & 0xffffffffffffULL;
+		size_t low = 0, high = ref_count[k];
+
+		while (low < high) {
+			size_t mid = (low + high) / 2;
+
+			if (ref_table[k][mid].prefix < prefix)
+				low = mid + 1;
+			else
+				high = mid;
+		}
+		if (low < ref_count[k] && ref_table[k][low].prefix == prefix) {
+			if (assigned)
+				*assigned = 1;
+			return ref_table[k][low].name;
+		}
+	}
+
+	if ((mac48 & (MAC48_LOCAL_BIT | MAC48_GROUP_BIT)) == MAC48_LOCAL_BIT)
+		return ref_local;
+	return ref_unassigned;
+}
+
+static int is_unassigned(const char *vendor)
+{
+	return vendor == NULL || strcmp(vendor, "Unknown") == 0 ||
+	       strcmp(vendor, ref_unassigned) == 0 || strcmp(vendor, ref_local) == 0;
+}
+
+static int answer_matches(const struct engine *e, const char *got, const char *want)
+{
+	int assigned = want != ref_unassigned && want != ref_local;
+
+	if (e->legacy && !assigned)
+		return is_unassigned(got);
+	return got && strcmp(got, want) == 0;
+}
+
+/* the engines, n lookups from the i-th MAC */
+
+static void run_linear(struct workload *w, size_t i, size_t n, const char **out)
+{
+	for (size_t j = i; j < i + n; j++)
+		out[j] = get_vendor_by_mac(w->str[j]);
+}
+
+static void run_binary(struct workload *w, size_t i, size_t n, const char **out)
+{
+	for (size_t j = i; j < i + n; j++)
+		out[j] = get_vendor_by_mac_binary(w->str[j]);
+}
+
+static void run_binary_ulmac(struct workload *w, size_t i, size_t n, const char **out)
+{
+	for (size_t j = i; j < i + n; j++)
+		out[j] = get_vendor_by_mac_binary_ulmac(w->str[j]);
+}
+
+static void run_hashtable(struct workload *w, size_t i, size_t n, const char **out)
+{
+	for (size_t j = i; j < i + n; j++)
+		out[j] = get_vendor_by_mac_hashtable(w->str[j]);
+}
+
+static void run_trie(struct workload *w, size_t i, size_t n, const char **out)
+{
+	for (size_t j = i; j < i + n; j++)
+		out[j] = get_vendor_by_mac_trie(w->str[j]);
+}
+
+static void run_bssid(struct workload *w, size_t i, size_t n, const char **out)
+{
+	for (size_t j = i; j < i + n; j++)
+		out[j] = get_vendor_by_bssid(w->bssid[j], NULL);
+}
+
+static void run_batch(struct workload *w, size_t i, size_t n, const char **out)
+{
+	get_vendors_by_macs(w->bssid[i], sizeof(w->bssid[i]), n, out + i, NULL);
+}
+
+static const struct engine engines[] = {
+	{ "linear",	  1, BENCH_LINEAR, run_linear },
+	{ "binary",	  1, 0, run_binary },
+	{ "binary_ulmac", 1, 0, run_binary_ulmac },
+	{ "hashtable",	  0, 0, run_hashtable },
+	{ "trie",	  0, 0, run_trie },
+	{ "bssid",	  0, 0, run_bssid },
+	{ "batch",	  0, 0, run_batch },
+};
+
+#define N_ENGINES (sizeof(engines) / sizeof(engines[0]))
+
+static int workload_alloc(struct workload *w, const char *name, size_t n)
+{
+	w->name = name;
+	w->n = n;
+	w->mac48 = calloc(n, sizeof(*w->mac48));
+	w->bssid = calloc(n, sizeof(*w->bssid));
+	w->str = calloc(n, sizeof(*w->str));
+	w->want = calloc(n, sizeof(*w->want));
+
+	return w->mac48 && w->bssid && w->str && w->want ? 0 : -1;
+}
+
+/* fills in the other forms of the MACs and the expected answers */
+static void workload_finish(struct workload *w)
+{
+	for (size_t i = 0; i < w->n; i++) {
+		uint64_t m = w->mac48[i];
+
+		for (int b = 0; b < 6; b++)
+			w->bssid[i][b] = m >> (40 - 8 * b);
+		snprintf(w->str[i], sizeof(w->str[i]), "%02X:%02X:%02X:%02X:%02X:%02X",
+			 w->bssid[i][0], w->bssid[i][1], w->bssid[i][2],
+			 w->bssid[i][3], w->bssid[i][4], w->bssid[i][5]);
+		w->want[i] = ref_find(m, NULL);
+	}
+}
+
+/* a random MAC inside a random assigned block */
+static uint64_t random_assigned(void)
+{
+	size_t total = ref_count[0] + ref_count[1] + ref_count[2];
+	size_t r = rng_next() % total;
+	int k;
+
+	for (k = 0; r >= ref_count[k]; k++)
+		r -= ref_count[k];
+
+	return ref_table[k][r].prefix | (rng_next() & ((1ULL << (48 - ref_bits[k])) - 1));
+}
+
+static int parse_mac(const char *p, uint64_t *mac48)
+{
+	unsigned int b[6];
+	int len = 0;
+
+	if (sscanf(p, "%2x:%2x:%2x:%2x:%2x:%2x%n", &b[0], &b[1], &b[2], &b[3], &b[4], &b[5], &len) != 6 ||
+	    len != 17)
+		return -1;
+
+	*mac48 = 0;
+	for (int i = 0; i < 6; i++)
+		*mac48 = *mac48 << 8 | b[i];
+
+	return 0;
+}
+
+static size_t load_bssids(const char *path, uint64_t **macs)
+{
+	FILE *f = fopen(path, "r");
+	size_t n = 0, cap = 0;
+	char line[1024];
+
+	if (!f)
+		return 0;
+
+	while (fgets(line, sizeof(line), f)) {
+		uint64_t m;
+
+		for (char *p = line; *p; p++) {
+			if (!isxdigit((unsigned char) *p) || parse_mac(p, &m) < 0)
+				continue;
+			if (n == cap) {
+				cap = cap ? cap * 2 : 256;
+				*macs = realloc(*macs, cap * sizeof(**macs));
+				if (!*macs) {
+					fclose(f);
+					return 0;
+				}
+			}
+			(*macs)[n++] = m;
+			break;
+		}
+	}
+	fclose(f);
+
+	return n;
+}
+
+static int workloads_build(struct workload *w, size_t n, const char *bssid_file)
+{
+	uint64_t *bssids = NULL, aps[BENCH_APS], m;
+	size_t n_bssids = 0;
+
+	if (bssid_file && (n_bssids = load_bssids(bssid_file, &bssids)) == 0) {
+		fprintf(stderr, "%s: no MACs found.\n", bssid_file);
+		return -1;
+	}
+
+	if (workload_alloc(&w[0], "random", n) < 0 ||
+	    workload_alloc(&w[1], "assigned", n) < 0 ||
+	    workload_alloc(&w[2], "sequential", n) < 0 ||
+	    workload_alloc(&w[3], "unknown", n) < 0 ||
+	    workload_alloc(&w[4], "bssid", n) < 0)
+		return -1;
+
+	for (size_t i = 0; i < n; i++)
+		w[0].mac48[i] = rng_next() >> 16;
+
+	for (size_t i = 0; i < n; i++)
+		w[1].mac48[i] = random_assigned();
+
+	m = rng_next() >> 16;
+	for (size_t i = 0; i < n; i++) {
+		w[2].mac48[i] = m;
+		m = (m + (1ULL << 24)) & 0xffffffffffffULL;
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		int assigned;
+
+		do
+			m = rng_next() >> 16;
+		while (ref_find(m, &assigned), assigned);
+		w[3].mac48[i] = m;
+	}
+
+	/* a scan sees the same few access points again and again, the nearest
+	   ones the most often */
+	for (int a = 0; a < BENCH_APS; a++)
+		aps[a] = a % 3 ? random_assigned() : (rng_next() >> 16 | MAC48_LOCAL_BIT) & ~MAC48_GROUP_BIT;
+	for (size_t i = 0; i < n; i++) {
+		if (n_bssids)
+			w[4].mac48[i] = bssids[i % n_bssids];
+		else {
+			size_t a = rng_next() % BENCH_APS, b = rng_next() % BENCH_APS;
+
+			w[4].mac48[i] = aps[a < b ? a : b];
+		}
+	}
+	if (n_bssids)
+		w[4].name = "bssid-file";
+	free(bssids);
+
+	for (int k = 0; k < 5; k++)
+		workload_finish(&w[k]);
+
+	return 0;
+}
+
+static int double_compare(const void *a, const void *b)
+{
+	double x = *(const double *) a, y = *(const double *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Times one engine on one workload and checks its answers. Returns the
+   number of wrong answers. */
+static size_t bench_run(const struct engine *e, struct workload *w, const char **out, double *samples)
+{
+	size_t n = e->max_lookups && e->max_lookups < w->n ? e->max_lookups : w->n;
+	size_t n_samples = 0, wrong = 0;
+	unsigned long long total = 0, misses = 0;
+	int perf = perf_open();
+	char misses_text[32] = "n/a";
+
+	if (perf >= 0) {
+		ioctl(perf, PERF_EVENT_IOC_RESET, 0);
+		ioctl(perf, PERF_EVENT_IOC_ENABLE, 0);
+	}
+
+	for (size_t i = 0; i < n; i += BENCH_BATCH) {
+		size_t k = n - i < BENCH_BATCH ? n - i : BENCH_BATCH;
+		unsigned long long t = time_ns();
+
+		e->run(w, i, k, out);
+		t = time_ns() - t;
+		total += t;
+		samples[n_samples++] = (double) t / k;
+	}
+
+	if (perf >= 0) {
+		ioctl(perf, PERF_EVENT_IOC_DISABLE, 0);
+		if (read(perf, &misses, sizeof(misses)) == sizeof(misses))
+			snprintf(misses_text, sizeof(misses_text), "%.3f", (double) misses / n);
+		close(perf);
+	}
+
+	qsort(samples, n_samples, sizeof(*samples), double_compare);
+
+	for (size_t i = 0; i < n; i++) {
+		if (answer_matches(e, out[i], w->want[i]))
+			continue;
+		if (wrong++ < BENCH_SHOW && !e->legacy)
+			fprintf(stderr, "  %s/%s: %s is '%s', expected '%s'\n", e->name, w->name,
+				w->str[i], out[i] ? out[i] : "(null)", w->want[i]);
+	}
+
+	printf("%-12s %-10s %7zu %8.1f %8.1f %8.1f %8.1f %9.1f %8s %6zu%s\n",
+	       e->name, w->name, n, (double) total / n,
+	       samples[n_samples / 2], samples[n_samples * 90 / 100],
+	       samples[n_samples * 99 / 100], samples[n_samples - 1],
+	       misses_text, wrong, wrong && e->legacy ? " (legacy)" : "");
+
+	return e->legacy ? 0 : wrong;
+}
+
+/* What the loaded table is made of, from vendor_db_stats(). */
+static void bench_stats(void)
+{
+	struct vendor_db_stats st;
+
+	if (vendor_db_stats(vendor_db_current(), &st) < 0)
+		return;
+
+	printf("entries %zu (MA-L %zu, MA-M %zu, MA-S %zu), vendors %zu\n",
+	       st.entries, st.entries_by_type[0], st.entries_by_type[1], st.entries_by_type[2], st.names);
+	printf("bytes: entries %zu, names %zu, strings %zu, trie %zu, hash %zu, oui map %zu, name index %zu, trigrams %zu; image %zu\n",
+	       st.bytes_entries, st.bytes_names, st.bytes_strings, st.bytes_trie, st.bytes_hash,
+	       st.bytes_oui_map, st.bytes_name_index, st.bytes_trigrams, st.bytes_image);
+	printf("hash: %u keys in %u slots, probe length p50 %u, p90 %u, p99 %u, max %u\n",
+	       st.hash_keys, st.hash_slots, st.psl_p50, st.psl_p90, st.psl_p99, st.psl_max);
+	printf("build ms: read %.2f, parse %.2f, sort %.2f, index %.2f\n",
+	       st.build_ns[VENDOR_PHASE_READ] / 1e6, st.build_ns[VENDOR_PHASE_PARSE] / 1e6,
+	       st.build_ns[VENDOR_PHASE_SORT] / 1e6, st.build_ns[VENDOR_PHASE_INDEX] / 1e6);
+}
+
+/* Loads the table BENCH_LOADS times and reports the best time and the
+   memory it takes. Returns the number of entries. */
+static int bench_load(const char *kind, const char *path)
+{
+	unsigned long long best = ~0ULL;
+	size_t rss = 0;
+	int n = 0;
+
+	for (int i = 0; i < BENCH_LOADS; i++) {
+		unsigned long long t;
+		size_t before;
+
+		vendor_release();
+		before = rss_bytes();
+		t = time_ns();
+		n = vendor_initialise(path);
+		t = time_ns() - t;
+		if (n <= 0) {
+			fprintf(stderr, "%s: Problem processing mac vendors list.\n", path);
+			return n;
+		}
+		if (t < best)
+			best = t;
+		rss = rss_bytes() - before;
+	}
+
+	printf("\nload %-5s %s: %d entries, best %.2f ms of %d, rss +%.2f MB\n",
+	       kind, path, n, best / 1e6, BENCH_LOADS, rss / 1048576.0);
+	bench_stats();
+	putchar('\n');
+	printf("%-12s %-10s %7s %8s %8s %8s %8s %9s %8s %6s\n",
+	       "engine", "workload", "lookups", "mean ns", "p50", "p90", "p99", "max",
+	       "miss/lk", "wrong");
+
+	return n;
+}
+
+static size_t bench_all(struct workload *w, const char **out, double *samples)
+{
+	size_t wrong = 0;
+
+	struct vendor_db_stats st;
+	size_t found;
+
+	for (size_t e = 0; e < N_ENGINES; e++)
+		for (int k = 0; k < 5; k++)
+			wrong += bench_run(&engines[e], &w[k], out, samples);
+
+	/* the lookup counters have to agree with what the batch lookup says */
+	vendor_count_lookups(1);
+	found = get_vendors_by_macs(w[0].bssid[0], sizeof(w[0].bssid[0]), w[0].n, out, NULL);
+	vendor_count_lookups(0);
+	vendor_db_stats(vendor_db_current(), &st);
+	if (st.lookups != w[0].n || st.hits != found) {
+		fprintf(stderr, "  counters: %llu lookups, %llu hits; expected %zu, %zu\n",
+			(unsigned long long) st.lookups, (unsigned long long) st.hits, w[0].n, found);
+		wrong++;
+	}
+
+	return wrong;
+}
+
+/* mac_find() on text where a wrong parse gives a MAC that is not there:
+   a run with a group too many must not turn into the MAC in its tail. */
+static const struct {
+	const char *text;
+	const char *mac;	/* what mac_find() has to find, or NULL */
+} find_cases[] = {
+	{ "lease 00:1a:2b:3c:4d:5e up",	"00:1a:2b:3c:4d:5e" },
+	{ "lease 00-1a-2b-3c-4d-5e up",	"00:1a:2b:3c:4d:5e" },
+	{ "lease 001a.2b3c.4d5e up",	"00:1a:2b:3c:4d:5e" },
+	{ "lease 001a2b3c4d5e up",	"00:1a:2b:3c:4d:5e" },
+	{ "12:34:56:78:9a:bc:de",	NULL },
+	{ "12-34-56-78-9a-bc-de",	NULL },
+	{ "1234.5678.9abc.def0",	NULL },
+	{ "fe80::12:34:56:78:9a:bc",	NULL },
+};
+
+static size_t check_mac_find(void)
+{
+	size_t wrong = 0;
+
+	for (size_t i = 0; i < sizeof(find_cases) / sizeof(find_cases[0]); i++) {
+		const char *text = find_cases[i].text, *want = find_cases[i].mac;
+		char got[18] = "";
+		uint8_t mac[6];
+
+		if (mac_find(text, strlen(text), mac, NULL))
+			snprintf(got, sizeof(got), "%02x:%02x:%02x:%02x:%02x:%02x",
+				 mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+		if (want ? strcmp(got, want) != 0 : got[0] != '\0') {
+			fprintf(stderr, "  mac_find(\"%s\"): got %s, expected %s\n",
+				text, got[0] ? got : "none", want ? want : "none");
+			wrong++;
+		}
+	}
+
+	return wrong;
+}
+
+int main (int argc, char *argv[])
+{
+	size_t n = BENCH_LOOKUPS, wrong;
+	unsigned long long seed = 0x5eed;
+	const char *bssid_file = NULL, *image = NULL, *csv;
+	struct workload w[5];
+	const char **out;
+	double *samples;
+	int opt, n_ref;
+
+	while ((opt = getopt(argc, argv, "n:s:b:i:")) != -1) {
+		switch (opt) {
+		case 'n':
+			n = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			seed = strtoull(optarg, NULL, 0);
+			break;
+		case 'b':
+			bssid_file = optarg;
+			break;
+		case 'i':
+			image = optarg;
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-n lookups] [-s seed] [-b bssids.txt] [-i mac-vendors.db] mac-vendors-export.csv\n", argv[0]);
+			exit(1);
+		}
+	}
+
+	if (optind != argc - 1 || n == 0) {
+		fprintf(stderr, "Usage: %s [-n lookups] [-s seed] [-b bssids.txt] [-i mac-vendors.db] mac-vendors-export.csv\n", argv[0]);
+		exit(1);
+	}
+	csv = argv[optind];
+
+	if ((n_ref = ref_load(csv)) <= 0) {
+		fprintf(stderr, "%s: Problem building the reference table.\n", csv);
+		exit(1);
+	}
+
+	rng_state = seed ? seed : 1;
+	out = calloc(n, sizeof(*out));
+	samples = calloc(n / BENCH_BATCH + 1, sizeof(*samples));
+	if (!out || !samples || workloads_build(w, n, bssid_file) < 0) {
+		fprintf(stderr, "%s: Out of memory.\n", argv[0]);
+		exit(1);
+	}
+
+	printf("mac-table-bench: %d reference entries, seed %#llx, %zu lookups per run\n", n_ref, seed, n);
+
+	if (bench_load("csv", csv) <= 0)
+		exit(1);
+	wrong = check_mac_find();
+	wrong += bench_all(w, out, samples);
+
+	if (image) {
+		if (bench_load("image", image) <= 0)
+			exit(1);
+		wrong += bench_all(w, out, samples);
+	}
+
+	vendor_release();
+
+	if (wrong) {
+		printf("\n%zu wrong answers.\n", wrong);
+		return 1;
+	}
+
+	return 0;
+}
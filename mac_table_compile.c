@@ -0,0 +1,40 @@
+/*
+ *
+ * Compile the MAC vendor CSV into a binary image
+ *
+ * Usage: mac-table-compile mac-vendors-export.csv mac-vendors.db
+ *
+ * The image holds the vendor table already sorted, so vendor_initialise()
+ * only has to mmap() it instead of parsing and sorting 49k CSV lines.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "get_mac_table.h"
+
+int main (int argc, char *argv[])
+{
+	struct vendor_db_stats st;
+	int n;
+
+	if (argc != 3) {
+		fprintf(stderr, "Usage: %s mac-vendors-export.csv mac-vendors.db\n", argv[0]);
+		exit(1);
+	}
+
+	if ((n = vendor_initialise(argv[1])) <= 0) {
+		fprintf(stderr, "%s: Problem processing mac vendors list.\n", argv[1]);
+		exit(1);
+	}
+
+	if (vendor_write_image(argv[2]) < 0) {
+		fprintf(stderr, "%s: Problem writing vendor image.\n", argv[2]);
+		exit(1);
+	}
+
+	vendor_db_stats(vendor_db_current(), &st);
+	printf("%s: %d vendor entries, %zu vendors, %zu bytes written.\n", argv[2], n, st.names, st.bytes_image);
+
+	return 0;
+}
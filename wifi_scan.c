@@ -30,6 +30,35 @@
   * wifi_scan_all reads up any pending notifications, commands a trigger if necessary, waits for the device to gather
   * results and finally reads scan results with get_scan function (those are fresh results)
   *
+  * wifi_scan_all waits only until a deadline (wait_for_scan), then aborts the scan with NL80211_CMD_ABORT_SCAN
+  * and returns ETIMEDOUT; a scan aborted by the driver or anybody else (NL80211_CMD_SCAN_ABORTED) ends it with
+  * ECANCELED. The notifications of other interfaces are ignored, the scan group carries those of all of them.
+  * Nothing on the scanning paths dies, errors are returned with errno set.
+  *
+  * wifi_scan_trigger/wifi_scan_get_fd/wifi_scan_process/wifi_scan_results are the same steps one at a time
+  * for programs with their own event loop. The notifications channel is non-blocking from wifi_scan_init on,
+  * it is only ever read when there is something to read (or to drain it); wifi_scan_all waits for it with poll.
+  *
+  * Scan results are handed out one BSS at a time as they are parsed from the dump (parse_NL80211_ATTR_BSS),
+  * to a callback: the caller's (wifi_scan_results_callback), one filling a fixed array (wifi_scan_all,
+  * wifi_scan_results) or one appending to a bss_list that grows as needed (wifi_scan_results_list).
+  *
+  * wifi_scan_trigger_params/wifi_scan_all_params do the same but scan only the frequencies asked for, probe for
+  * the SSIDs asked for and stay on each channel as long as asked (attributes of NL80211_CMD_TRIGGER_SCAN).
+  *
+  * The scan flags (NL80211_ATTR_SCAN_FLAGS) are only sent when the device supports them, which is asked once
+  * with a NL80211_CMD_GET_WIPHY dump (feature flags and extended features), see get_wiphy_features.
+  *
+  * wifi_scan_rolling_* scan a few channels at a time (wifi_scan_trigger_params with the frequencies of the group)
+  * and merge each scan into a view of all the channels (merge_rolling_bss), the groups are picked by
+  * pick_rolling_group, from how long the channels waited and what was found on them.
+  *
+  * bss_diff and wifi_scan_pacing_* help decide when to scan next, from the changes between scans, failed triggers
+  * and the traffic of the link; they don't talk to the kernel.
+  *
+  * wifi_scan_cached only dumps what the kernel already knows (NL80211_CMD_GET_SCAN), which other programs keep
+  * fresh: no trigger, no waiting and no permissions needed, and the state of a scan in progress is left alone.
+  *
   * wifi_scan_close frees up resources of two channels and any other resoureces that library uses.
   *
   * prepare_nl_messsage/send_nl_message/receive_nl_message are helper functions to simplify common tasks when issuing commands
@@ -39,6 +68,7 @@
   */
 
 #include "wifi_scan.h"
+#include "wifi_chan.h" //the band plan
 
 #include <libmnl/libmnl.h> //netlink libmnl
 #include <linux/nl80211.h> //nl80211 netlink
@@ -51,6 +81,8 @@
 #include <stdlib.h>
 #include <fcntl.h> //fntnl (set descriptor options)
 #include <errno.h> //errno
+#include <poll.h> //poll
+#include <time.h> //clock_gettime
 
 // everything needed for sending/receiving with netlink
 struct netlink_channel
@@ -63,11 +95,32 @@ struct netlink_channel
 	void *context; //additional data to be stored/used when processing concrete message
 };
 
+// the data needed from notifications
+struct context_NL80211_MULTICAST_GROUP_SCAN
+{
+	uint32_t ifindex; //our interface, the notifications of the others are ignored
+	int new_scan_results; //are new scan results waiting for us?
+	int scan_triggered; //was scan was already triggered by somebody else?
+	int scan_aborted; //was the scan aborted before the results?
+};
+
+// the data needed from wiphy information
+struct context_NL80211_CMD_NEW_WIPHY
+{
+	int queried; //was the kernel asked already?
+	uint32_t scan_flags; //enum wifi_scan_flags supported by the device
+	int scan_dwell; //can the device take dwell time?
+	uint32_t frequencies[WIFI_SCAN_MAX_FREQUENCIES]; //the channels the device can use, in MHz
+	int frequencies_length; //0 if the kernel wouldn't tell
+};
+
 // internal library data passed around by user
 struct wifi_scan
 {
 	struct netlink_channel notification_channel;
 	struct netlink_channel command_channel;
+	struct context_NL80211_MULTICAST_GROUP_SCAN scanning; //what the notifications told us so far, until the results are read
+	struct context_NL80211_CMD_NEW_WIPHY wiphy; //what the device supports, asked when first needed
 };
 
 // DECLARATIONS AND TOP-DOWN LIBRARY OVERVIEW
@@ -110,51 +163,181 @@ static void close_netlink_channel(struct netlink_channel *channel);
 // public interface - trigger scan if necessary, retrieve information about all known BSSes
 int wifi_scan_all(struct wifi_scan *wifi, struct bss_info *bss_infos, int bss_infos_length);
 
-// SCANNING - notification related
+// public interface - the steps of wifi_scan_all for event loops
+int wifi_scan_get_fd(struct wifi_scan *wifi);
+int wifi_scan_trigger(struct wifi_scan *wifi);
+int wifi_scan_process(struct wifi_scan *wifi);
+int wifi_scan_results(struct wifi_scan *wifi, struct bss_info *bss_infos, int bss_infos_length);
+int wifi_scan_abort(struct wifi_scan *wifi);
+// public interface - results as they are parsed, or all of them in a growing list
+int wifi_scan_results_callback(struct wifi_scan *wifi, wifi_scan_callback callback, void *data);
+int wifi_scan_results_list(struct wifi_scan *wifi, struct bss_list *list);
+int wifi_scan_all_list(struct wifi_scan *wifi, struct bss_list *list);
+void bss_list_free(struct bss_list *list);
+// public interface - what the kernel has already, without a scan
+int wifi_scan_cached(struct wifi_scan *wifi, struct bss_info *bss_infos, int bss_infos_length, int max_age_ms);
+int wifi_scan_cached_list(struct wifi_scan *wifi, struct bss_list *list, int max_age_ms);
+int wifi_scan_cached_callback(struct wifi_scan *wifi, wifi_scan_callback callback, void *data, int max_age_ms);
+// public interface - scan only some channels, probe for some SSIDs, set dwell time
+int wifi_scan_trigger_params(struct wifi_scan *wifi, const struct wifi_scan_params *params);
+int wifi_scan_all_params(struct wifi_scan *wifi, const struct wifi_scan_params *params, struct bss_list *list);
+// public interface - the scan flags the device supports
+uint32_t wifi_scan_supported_flags(struct wifi_scan *wifi);
 
-// the data needed from notifications
-struct context_NL80211_MULTICAST_GROUP_SCAN
-{
-	int new_scan_results; //are new scan results waiting for us?
-	int scan_triggered; //was scan was already triggered by somebody else?
-};
+// SCANNING - notification related
 
 // read but do not block
-static void read_past_notifications(struct netlink_channel *notifications);
-// go non-blocking
+static int read_past_notifications(struct netlink_channel *notifications);
+// go non-blocking, once for good
 static void set_channel_non_blocking(struct netlink_channel *channel);
-// go back blocking
-static void set_channel_blocking(struct netlink_channel *channel);
 // this handles notifications
 static int handle_NL80211_MULTICAST_GROUP_SCAN(const struct nlmsghdr *nlh, void *data);
+// forget what the notifications told us, but not whose they are
+static void reset_scanning(struct context_NL80211_MULTICAST_GROUP_SCAN *scanning);
 // triggers scan if no results are waiting yet and if it was not already triggered
-static int trigger_scan_if_necessary(struct netlink_channel *commands, struct context_NL80211_MULTICAST_GROUP_SCAN *scanning);
-// triggers the scan
-static int trigger_scan(struct netlink_channel *channel);
-// wait for the notification that scan finished
-static void wait_for_new_scan_results(struct netlink_channel *notifications);
+static int trigger_scan_if_necessary(struct netlink_channel *commands, struct context_NL80211_MULTICAST_GROUP_SCAN *scanning, const struct wifi_scan_params *params);
+// are params something the kernel would take?
+static int valid_scan_params(const struct wifi_scan_params *params);
+// triggers the scan, params may be NULL
+static int trigger_scan(struct netlink_channel *channel, const struct wifi_scan_params *params);
+// the above with flags and dwell time as given rather than from params
+static int send_trigger_scan(struct netlink_channel *channel, const struct wifi_scan_params *params, uint32_t flags, int dwell_ms);
+// the frequencies to scan (nested attribute)
+static void put_NL80211_ATTR_SCAN_FREQUENCIES(struct nlmsghdr *nlh, const uint32_t *frequencies, int frequencies_length);
+// the SSIDs to probe for (nested attribute)
+static void put_NL80211_ATTR_SCAN_SSIDS(struct nlmsghdr *nlh, const char * const *ssids, int ssids_length);
+// wait for the scan to finish, abort it if it doesn't in time
+static int wait_for_scan(struct wifi_scan *wifi, int timeout_ms);
+// wait for the notification that scan finished, until timeout
+static int wait_for_new_scan_results(struct netlink_channel *notifications, int timeout_ms);
+// aborts the scan
+static int abort_scan(struct netlink_channel *channel);
+
+// SCANNING - device features
+
+// what the device supports, asks the kernel the first time
+static const struct context_NL80211_CMD_NEW_WIPHY *get_wiphy_features(struct wifi_scan *wifi);
+// execute command to get wiphy information of our interface
+static int get_wiphy(struct netlink_channel *channel);
+// process wiphy information (a part of it, the dump is split)
+static int handle_NL80211_CMD_NEW_WIPHY(const struct nlmsghdr *nlh, void *data);
+// is the extended feature in the bitmap (NL80211_ATTR_EXT_FEATURES)?
+static int ext_feature_isset(struct nlattr *attr, int ext_feature);
+// get the bands of the device (nested attribute)
+static void parse_NL80211_ATTR_WIPHY_BANDS(struct nlattr *nested, struct context_NL80211_CMD_NEW_WIPHY *wiphy);
+// get the channels which are not disabled (nested attribute)
+static void parse_NL80211_BAND_ATTR_FREQS(struct nlattr *nested, struct context_NL80211_CMD_NEW_WIPHY *wiphy);
 
 // SCANNING - scan related
 
 // the data needed from new scan results
 struct context_NL80211_CMD_NEW_SCAN_RESULTS
+{
+	wifi_scan_callback callback; //called for every BSS
+	void *data; //passed to the callback
+	int max_age_ms; //BSSes seen longer ago are skipped, 0 for none
+	int scanned;
+};
+
+// data for the callback filling caller's array
+struct bss_array
 {
 	struct bss_info *bss_infos;
 	int bss_infos_length;
 	int scanned;
 };
 
+// get the results with callback, it is what all the public interface ends up with
+static int get_scan_results(struct wifi_scan *wifi, wifi_scan_callback callback, void *data);
+// the above without ending the scan, for cached results
+static int dump_scan(struct wifi_scan *wifi, wifi_scan_callback callback, void *data, int max_age_ms);
 // get scan results cached by the driver
 static int get_scan(struct netlink_channel *channel);
+// callback storing BSS in struct bss_array
+static void store_bss_array(const struct bss_info *bss, void *data);
+// callback appending BSS to struct bss_list
+static void store_bss_list(const struct bss_info *bss, void *data);
 // process the new scan results
 static int handle_NL80211_CMD_NEW_SCAN_RESULTS(const struct nlmsghdr *nlh, void *data);
 // get the information about bss (nested attribute)
 static void parse_NL80211_ATTR_BSS(struct nlattr *nested, struct netlink_channel *channel);
+// is the BSS the one we are associated with?
+static int bss_associated(const struct bss_info *bss);
 // get the information from IE (non-netlink binary data here!)
 static void parse_NL80211_BSS_INFORMATION_ELEMENTS(struct nlattr *attr, char SSID_OUT[33]);
 // get BSSID (mac address)
 static void parse_NL80211_BSS_BSSID(struct nlattr *attr, uint8_t bssid_out[BSSID_LENGTH]);
 
+// ROLLING SCAN
+
+// a BSS of the rolling view, with the time it was seen rather than how long ago
+struct rolling_bss
+{
+	struct bss_info bss;
+	uint64_t seen_ms;
+};
+
+// what the schedule knows about a channel
+struct rolling_channel
+{
+	uint32_t frequency; //in MHz
+	uint64_t scanned_ms; //when it was scanned last time, 0 for never
+	int bss_count; //BSSes in the view on this channel
+	int changes; //BSSes new, gone or moved here, halved with every scan of the channel
+	int merge_changes; //the above, counted while merging the results
+	int in_group; //is it being scanned now?
+};
+
+// internal data of the rolling scan passed around by user
+struct wifi_scan_rolling
+{
+	struct wifi_scan *wifi;
+	struct wifi_scan_params params; //as given, but with the frequencies of the group
+	uint32_t group[WIFI_SCAN_MAX_FREQUENCIES]; //the frequencies of the group
+	struct rolling_channel channels[WIFI_SCAN_MAX_FREQUENCIES];
+	int channels_length;
+	int group_size;
+	uint64_t triggered_ms; //when our scan of the group was triggered, 0 if the scan is somebody else's
+	uint64_t now_ms; //when the results are merged
+	struct rolling_bss *view;
+	int view_length;
+	int view_size;
+};
+
+// public interface - scan a group of channels at a time, merge into a view of all of them
+struct wifi_scan_rolling *wifi_scan_rolling_init(struct wifi_scan *wifi, const struct wifi_scan_params *params, int group_size);
+int wifi_scan_rolling_trigger(struct wifi_scan_rolling *rolling);
+int wifi_scan_rolling_results(struct wifi_scan_rolling *rolling, struct bss_list *list);
+void wifi_scan_rolling_close(struct wifi_scan_rolling *rolling);
+
+// choose the channels to scan next
+static void pick_rolling_group(struct wifi_scan_rolling *rolling, uint64_t now_ms);
+// no channels being scanned
+static void clear_rolling_group(struct wifi_scan_rolling *rolling);
+// callback merging the BSS into the view
+static void merge_rolling_bss(const struct bss_info *bss, void *data);
+// drop from the view what is gone, count what is left, update the channel statistics
+static void end_rolling_merge(struct wifi_scan_rolling *rolling);
+// the channel of the schedule with the frequency or NULL
+static struct rolling_channel *find_rolling_channel(struct wifi_scan_rolling *rolling, uint32_t frequency);
+// monotonic clock in ms
+static uint64_t monotonic_ms(void);
+
+// PACING
+
+// public interface - what changed between two scans
+void bss_diff(const struct bss_info *before, int before_length, const struct bss_info *after, int after_length, struct bss_diff *diff);
+// public interface - when to scan next
+void wifi_scan_pacing_init(struct wifi_scan_pacing *pacing, int min_interval_ms, int max_interval_ms);
+int wifi_scan_pacing_results(struct wifi_scan_pacing *pacing, const struct bss_diff *diff, int bss_count);
+int wifi_scan_pacing_failed(struct wifi_scan_pacing *pacing, int error);
+int wifi_scan_pacing_link(struct wifi_scan_pacing *pacing, const struct station_info *station);
+
+// the time to wait from all of the above
+static int pacing_delay(const struct wifi_scan_pacing *pacing);
+// the BSS with the BSSID or NULL
+static const struct bss_info *find_bss(const struct bss_info *bss_infos, int bss_infos_length, const uint8_t bssid[BSSID_LENGTH]);
+
 // STATION
 
 // data needed from command new station
@@ -181,7 +364,7 @@ static void parse_NL80211_ATTR_STA_INFO(struct nlattr *nested, struct netlink_ch
 // mnl_attr_put_[|u8|u16|u32|u64|str|strz] and mnl_attr_nest_[start|end]
 static struct nlmsghdr *prepare_nl_message(uint32_t type, uint16_t flags, uint8_t genl_cmd, struct netlink_channel *channel);
 // send the above message
-static void send_nl_message(struct nlmsghdr *nlh, struct netlink_channel *channel);
+static int send_nl_message(struct nlmsghdr *nlh, struct netlink_channel *channel);
 // receive the results and process them using callback function
 static int receive_nl_message(struct netlink_channel *channel, mnl_cb_t callback);
 
@@ -236,11 +419,26 @@ const struct attribute_validation NL80211_BSS_VALIDATION[]={
  {NL80211_BSS_SIGNAL_MBM, MNL_TYPE_U32},
  {NL80211_BSS_SEEN_MS_AGO, MNL_TYPE_U32} };
 
+const struct attribute_validation NL80211_SCAN_NOTIFICATION_VALIDATION[]={
+ {NL80211_ATTR_IFINDEX, MNL_TYPE_U32} };
+
 const struct attribute_validation NL80211_NEW_SCAN_RESULTS_VALIDATION[]={
  {NL80211_ATTR_IFINDEX, MNL_TYPE_U32},
  {NL80211_ATTR_SCAN_SSIDS, MNL_TYPE_NESTED},
  {NL80211_ATTR_BSS, MNL_TYPE_NESTED} };
 
+const struct attribute_validation NL80211_NEW_WIPHY_VALIDATION[]={
+ {NL80211_ATTR_FEATURE_FLAGS, MNL_TYPE_U32},
+ {NL80211_ATTR_EXT_FEATURES, MNL_TYPE_BINARY},
+ {NL80211_ATTR_WIPHY_BANDS, MNL_TYPE_NESTED} };
+
+const struct attribute_validation NL80211_BAND_VALIDATION[]={
+ {NL80211_BAND_ATTR_FREQS, MNL_TYPE_NESTED} };
+
+const struct attribute_validation NL80211_FREQUENCY_VALIDATION[]={
+ {NL80211_FREQUENCY_ATTR_FREQ, MNL_TYPE_U32},
+ {NL80211_FREQUENCY_ATTR_DISABLED, MNL_TYPE_FLAG} };
+
 const struct attribute_validation NL80211_CMD_NEW_STATION_VALIDATION[]={
  {NL80211_ATTR_STA_INFO, MNL_TYPE_NESTED},
 };
@@ -255,7 +453,11 @@ const struct attribute_validation NL80211_STA_INFO_VALIDATION[]={
 const int NL80211_VALIDATION_LENGTH=sizeof(NL80211_VALIDATION)/sizeof(struct attribute_validation);
 const int NL80211_MCAST_GROUPS_VALIDATION_LENGTH=sizeof(NL80211_MCAST_GROUPS_VALIDATION)/sizeof(struct attribute_validation);
 const int NL80211_BSS_VALIDATION_LENGTH=sizeof(NL80211_BSS_VALIDATION)/sizeof(struct attribute_validation);
+const int NL80211_SCAN_NOTIFICATION_VALIDATION_LENGTH=sizeof(NL80211_SCAN_NOTIFICATION_VALIDATION)/sizeof(struct attribute_validation);
 const int NL80211_NEW_SCAN_RESULTS_VALIDATION_LENGTH=sizeof(NL80211_NEW_SCAN_RESULTS_VALIDATION)/sizeof(struct attribute_validation);
+const int NL80211_NEW_WIPHY_VALIDATION_LENGTH=sizeof(NL80211_NEW_WIPHY_VALIDATION)/sizeof(struct attribute_validation);
+const int NL80211_BAND_VALIDATION_LENGTH=sizeof(NL80211_BAND_VALIDATION)/sizeof(struct attribute_validation);
+const int NL80211_FREQUENCY_VALIDATION_LENGTH=sizeof(NL80211_FREQUENCY_VALIDATION)/sizeof(struct attribute_validation);
 const int NL80211_CMD_NEW_STATION_VALIDATION_LENGTH=sizeof(NL80211_CMD_NEW_STATION_VALIDATION)/sizeof(struct attribute_validation);
 const int NL80211_STA_INFO_VALIDATION_LENGTH=sizeof(NL80211_STA_INFO_VALIDATION)/sizeof(struct attribute_validation);
 
@@ -284,6 +486,15 @@ struct wifi_scan *wifi_scan_init(const char *interface)
 
 	subscribe_NL80211_MULTICAST_GROUP_SCAN(&wifi->notification_channel, family_context.id_NL80211_MULTICAST_GROUP_SCAN);
 
+	//notifications are only read when they are there, see wifi_scan_process
+	wifi->scanning.ifindex=wifi->notification_channel.ifindex;
+	reset_scanning(&wifi->scanning);
+	wifi->notification_channel.context=&wifi->scanning;
+
+	//asked only when flags or dwell time are used, see get_wiphy_features
+	memset(&wifi->wiphy, 0, sizeof(wifi->wiphy));
+	set_channel_non_blocking(&wifi->notification_channel);
+
 	return wifi;
 }
 
@@ -327,7 +538,8 @@ static int get_family_and_scan_ids(struct netlink_channel *channel)
 	mnl_attr_put_u16(nlh, CTRL_ATTR_FAMILY_ID, GENL_ID_CTRL);
 	mnl_attr_put_strz(nlh, CTRL_ATTR_FAMILY_NAME, NL80211_GENL_NAME);
 
-	send_nl_message(nlh, channel);
+	if(send_nl_message(nlh, channel) == -1)
+		return -1;
 
 	return receive_nl_message(channel, handle_CTRL_CMD_GETFAMILY);
 }
@@ -416,7 +628,6 @@ static void close_netlink_channel(struct netlink_channel *channel)
 
 // SCANNING
 
-// handle also trigger abort
 // public interface
 //
 // prerequisities:
@@ -424,27 +635,264 @@ static void close_netlink_channel(struct netlink_channel *channel)
 // - bss_info table of sized bss_info_length passed
 int wifi_scan_all(struct wifi_scan *wifi, struct bss_info *bss_infos, int bss_infos_length)
 {
-	struct netlink_channel *notifications=&wifi->notification_channel;
-	struct context_NL80211_MULTICAST_GROUP_SCAN scanning={0,0};
-	notifications->context=&scanning;
+	if( wifi_scan_trigger(wifi) == -1)
+		return -1; //most likely with errno set to EBUSY
 
-	struct netlink_channel *commands=&wifi->command_channel;
-	struct context_NL80211_CMD_NEW_SCAN_RESULTS scan_results = {bss_infos, bss_infos_length, 0};
-	commands->context=&scan_results;
+	//now just wait for trigger/new_scan_results
+	if( wait_for_scan(wifi, WIFI_SCAN_TIMEOUT_MS) == -1)
+		return -1; //errno set to ETIMEDOUT or ECANCELED if the scan was aborted
+
+	//finally read the scan
+	return wifi_scan_results(wifi, bss_infos, bss_infos_length);
+}
+
+// public interface
+//
+// prerequisities:
+// - wifi initialized with wifi_scan_init
+int wifi_scan_get_fd(struct wifi_scan *wifi)
+{
+	return mnl_socket_get_fd(wifi->notification_channel.nl);
+}
+
+// public interface
+//
+// prerequisities:
+// - wifi initialized with wifi_scan_init
+int wifi_scan_trigger(struct wifi_scan *wifi)
+{
+	return wifi_scan_trigger_params(wifi, NULL);
+}
+
+// public interface
+//
+// prerequisities:
+// - wifi initialized with wifi_scan_init
+// - params NULL or filled as described in wifi_scan.h
+int wifi_scan_trigger_params(struct wifi_scan *wifi, const struct wifi_scan_params *params)
+{
+	struct wifi_scan_params supported;
+
+	if(params != NULL && !valid_scan_params(params))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	//leave out what the device can't do, the kernel would refuse the whole scan otherwise
+	if(params != NULL && (params->flags != 0 || params->dwell_ms > 0))
+	{
+		const struct context_NL80211_CMD_NEW_WIPHY *wiphy = get_wiphy_features(wifi);
+
+		supported = *params;
+		supported.flags &= wiphy->scan_flags;
+		if(!wiphy->scan_dwell)
+			supported.dwell_ms = 0;
+		params = &supported;
+	}
 
 	//somebody else might have triggered scanning or even the results can be already waiting
-	read_past_notifications(notifications);
+	if(read_past_notifications(&wifi->notification_channel) == -1)
+		return -1;
+
+	//the abort of an earlier scan which we didn't wait for, it says nothing about this one
+	if(wifi->scanning.scan_aborted)
+		reset_scanning(&wifi->scanning);
 
 	//if no results yet or scan not triggered then trigger it.
 	//the device can be busy - we have to take it into account
-	if( trigger_scan_if_necessary(commands, &scanning) == -1)
+	return trigger_scan_if_necessary(&wifi->command_channel, &wifi->scanning, params);
+}
+
+// public interface
+//
+// prerequisities:
+// - wifi initialized with wifi_scan_init
+// - params NULL or filled as described in wifi_scan.h
+// - list zeroed or filled before by the library
+int wifi_scan_all_params(struct wifi_scan *wifi, const struct wifi_scan_params *params, struct bss_list *list)
+{
+	if( wifi_scan_trigger_params(wifi, params) == -1)
 		return -1; //most likely with errno set to EBUSY
 
-	//now just wait for trigger/new_scan_results
-	wait_for_new_scan_results(notifications);
+	if( wait_for_scan(wifi, params != NULL && params->timeout_ms > 0 ? params->timeout_ms : WIFI_SCAN_TIMEOUT_MS) == -1)
+		return -1;
 
-	//finally read the scan
-	get_scan(commands);
+	return wifi_scan_results_list(wifi, list);
+}
+
+// public interface
+//
+// prerequisities:
+// - wifi initialized with wifi_scan_init
+int wifi_scan_process(struct wifi_scan *wifi)
+{
+	if(read_past_notifications(&wifi->notification_channel) == -1)
+		return -1;
+
+	//no results will come, the next scan starts from scratch
+	if(wifi->scanning.scan_aborted && !wifi->scanning.new_scan_results)
+	{
+		reset_scanning(&wifi->scanning);
+		errno = ECANCELED;
+		return -1;
+	}
+
+	return wifi->scanning.new_scan_results;
+}
+
+// public interface
+//
+// prerequisities:
+// - wifi initialized with wifi_scan_init
+int wifi_scan_abort(struct wifi_scan *wifi)
+{
+	if(abort_scan(&wifi->command_channel) == 0)
+		return 0; //NL80211_CMD_SCAN_ABORTED tells the rest, see wifi_scan_process
+
+	//no scan in progress, whatever we were waiting for is not coming
+	if(errno == ENOENT)
+		reset_scanning(&wifi->scanning);
+
+	return -1;
+}
+
+// public interface
+//
+// prerequisities:
+// - wifi initialized with wifi_scan_init
+// - bss_info table of sized bss_info_length passed
+int wifi_scan_results(struct wifi_scan *wifi, struct bss_info *bss_infos, int bss_infos_length)
+{
+	struct bss_array array = {bss_infos, bss_infos_length, 0};
+
+	if(get_scan_results(wifi, store_bss_array, &array) == -1)
+		return -1;
+
+	return array.scanned;
+}
+
+// public interface
+//
+// prerequisities:
+// - wifi initialized with wifi_scan_init
+// - callback not calling the library
+int wifi_scan_results_callback(struct wifi_scan *wifi, wifi_scan_callback callback, void *data)
+{
+	return get_scan_results(wifi, callback, data);
+}
+
+// public interface
+//
+// prerequisities:
+// - wifi initialized with wifi_scan_init
+// - list zeroed or filled before by the library
+int wifi_scan_results_list(struct wifi_scan *wifi, struct bss_list *list)
+{
+	list->length = 0;
+
+	if(get_scan_results(wifi, store_bss_list, list) == -1)
+		return -1;
+
+	return list->length;
+}
+
+// public interface
+//
+// prerequisities:
+// - wifi initialized with wifi_scan_init
+// - list zeroed or filled before by the library
+int wifi_scan_all_list(struct wifi_scan *wifi, struct bss_list *list)
+{
+	if( wifi_scan_trigger(wifi) == -1)
+		return -1; //most likely with errno set to EBUSY
+
+	if( wait_for_scan(wifi, WIFI_SCAN_TIMEOUT_MS) == -1)
+		return -1;
+
+	return wifi_scan_results_list(wifi, list);
+}
+
+// public interface
+//
+// prerequisities:
+// - wifi initialized with wifi_scan_init
+uint32_t wifi_scan_supported_flags(struct wifi_scan *wifi)
+{
+	return get_wiphy_features(wifi)->scan_flags;
+}
+
+// public interface
+void bss_list_free(struct bss_list *list)
+{
+	free(list->bss);
+	list->bss = NULL;
+	list->length = list->size = 0;
+}
+
+// public interface
+//
+// prerequisities:
+// - wifi initialized with wifi_scan_init
+// - bss_info table of sized bss_info_length passed
+int wifi_scan_cached(struct wifi_scan *wifi, struct bss_info *bss_infos, int bss_infos_length, int max_age_ms)
+{
+	struct bss_array array = {bss_infos, bss_infos_length, 0};
+
+	if(dump_scan(wifi, store_bss_array, &array, max_age_ms) == -1)
+		return -1;
+
+	return array.scanned;
+}
+
+// public interface
+//
+// prerequisities:
+// - wifi initialized with wifi_scan_init
+// - list zeroed or filled before by the library
+int wifi_scan_cached_list(struct wifi_scan *wifi, struct bss_list *list, int max_age_ms)
+{
+	list->length = 0;
+
+	if(dump_scan(wifi, store_bss_list, list, max_age_ms) == -1)
+		return -1;
+
+	return list->length;
+}
+
+// public interface
+//
+// prerequisities:
+// - wifi initialized with wifi_scan_init
+// - callback not calling the library
+int wifi_scan_cached_callback(struct wifi_scan *wifi, wifi_scan_callback callback, void *data, int max_age_ms)
+{
+	return dump_scan(wifi, callback, data, max_age_ms);
+}
+
+// prerequisities:
+// - wifi initialized with wifi_scan_init
+static int get_scan_results(struct wifi_scan *wifi, wifi_scan_callback callback, void *data)
+{
+	int scanned = dump_scan(wifi, callback, data, 0);
+
+	//the next scan starts from scratch
+	if(scanned != -1)
+		reset_scanning(&wifi->scanning);
+
+	return scanned;
+}
+
+// prerequisities:
+// - wifi initialized with wifi_scan_init
+static int dump_scan(struct wifi_scan *wifi, wifi_scan_callback callback, void *data, int max_age_ms)
+{
+	struct netlink_channel *commands=&wifi->command_channel;
+	struct context_NL80211_CMD_NEW_SCAN_RESULTS scan_results = {callback, data, max_age_ms, 0};
+	commands->context=&scan_results;
+
+	if(get_scan(commands) == -1)
+		return -1;
 
 	return scan_results.scanned;
 }
@@ -454,9 +902,9 @@ int wifi_scan_all(struct wifi_scan *wifi, struct bss_info *bss_infos, int bss_in
 // prerequisities
 // - subscribed to scan group with subscribe_NL80211_MULTICAST_GROUP_SCAN
 // - context_NL80211_MULTICAST_GROUP_SCAN set for notifications
-static void read_past_notifications(struct netlink_channel *notifications)
+// - notifications set non blocking with set_channel_non_blocking
+static int read_past_notifications(struct netlink_channel *notifications)
 {
-	set_channel_non_blocking(notifications);
 	int ret, run_ret;
 
 	while( (ret = mnl_socket_recvfrom(notifications->nl, notifications->buf, MNL_SOCKET_BUFFER_SIZE) ) >= 0)
@@ -464,14 +912,14 @@ static void read_past_notifications(struct netlink_channel *notifications)
 		//the line below fills context about past scans/triggers
 		run_ret = mnl_cb_run(notifications->buf, ret, 0, 0, handle_NL80211_MULTICAST_GROUP_SCAN, notifications);
 		if(run_ret <= 0)
-			die_errno("ReadPastNotificationsNonBlocking mnl_cb_run failed");
+			return -1;
 	}
 
 	if(ret == -1)
-		if( !(errno == EINPROGRESS || errno == EWOULDBLOCK) )
-			die_errno("ReadPastNotificationsNonBlocking mnl_socket_recv failed");
+		if( !(errno == EINPROGRESS || errno == EWOULDBLOCK || errno == EINTR) )
+			return -1;
 	//no more notifications waiting
-	set_channel_blocking(notifications);
+	return 0;
 }
 
 // prerequisities
@@ -486,18 +934,6 @@ static void set_channel_non_blocking(struct netlink_channel *channel)
 		die_errno("SetChannelNonBlocking F_SETFL");
 }
 
-// prerequisities
-// - channel initialized with init_netlink_channel
-static void set_channel_blocking(struct netlink_channel *channel)
-{
-	int fd = mnl_socket_get_fd(channel->nl);
-	int flags = fcntl(fd, F_GETFL, 0);
-	if(flags == -1)
-		die_errno("SetChannelNonBlocking F_GETFL");
-	if( fcntl(fd, F_SETFL, flags &  ~O_NONBLOCK) == -1)
-		die_errno("SetChannelNonBlocking F_SETFL");
-}
-
 // prerequisities:
 // - subscribed to scan group with subscribe_NL80211_MULTICAST_GROUP_SCAN
 // - netlink_channel passed as data
@@ -506,10 +942,18 @@ static int handle_NL80211_MULTICAST_GROUP_SCAN(const struct nlmsghdr *nlh, void
 {
 	struct netlink_channel *channel=data;
 	struct context_NL80211_MULTICAST_GROUP_SCAN *context = channel->context;
+	struct nlattr *tb[NL80211_ATTR_MAX+1] = {};
+	struct validation_data vd={tb, NL80211_ATTR_MAX, NL80211_SCAN_NOTIFICATION_VALIDATION, NL80211_SCAN_NOTIFICATION_VALIDATION_LENGTH};
 
 	struct genlmsghdr *genl = (struct genlmsghdr *)mnl_nlmsg_get_payload(nlh);
 
 //	printf("Got message type %d seq %d pid  %d genl cmd %d \n", nlh->nlmsg_type, nlh->nlmsg_seq, nlh->nlmsg_pid, genl->cmd);
+
+	//the scan group carries the scans of all the wireless interfaces, only ours count
+	mnl_attr_parse(nlh, sizeof(*genl), validate, &vd);
+	if(!tb[NL80211_ATTR_IFINDEX] || mnl_attr_get_u32(tb[NL80211_ATTR_IFINDEX]) != context->ifindex)
+		return MNL_CB_OK;
+
 	if(genl->cmd == NL80211_CMD_TRIGGER_SCAN)
 	{
 		context->scan_triggered=1;
@@ -523,6 +967,16 @@ static int handle_NL80211_MULTICAST_GROUP_SCAN(const struct nlmsghdr *nlh, void
 			context->new_scan_results = 1;
 		return MNL_CB_OK; //do nothing for now
 	}
+	else if(genl->cmd == NL80211_CMD_SCAN_ABORTED)
+	{
+		//by wifi_scan_abort, somebody else or the driver itself, no results will come
+		if(nlh->nlmsg_pid==0 &&  nlh->nlmsg_seq==0)
+		{
+			context->scan_aborted = 1;
+			context->scan_triggered = 0;
+		}
+		return MNL_CB_OK;
+	}
 	else
 	{
 		fprintf(stderr, "Ignoring generic netlink command type %u seq %u pid  %u genl cmd %u\n",nlh->nlmsg_type, nlh->nlmsg_seq, nlh->nlmsg_pid, genl->cmd);
@@ -530,59 +984,346 @@ static int handle_NL80211_MULTICAST_GROUP_SCAN(const struct nlmsghdr *nlh, void
 	}
 }
 
+static void reset_scanning(struct context_NL80211_MULTICAST_GROUP_SCAN *scanning)
+{
+	scanning->new_scan_results=0;
+	scanning->scan_triggered=0;
+	scanning->scan_aborted=0;
+}
 
 // prerequisities:
 // - commands initialized with init_netlink_channel
 // - scanning updated with read_past_notifications
-static int trigger_scan_if_necessary(struct netlink_channel *commands, struct context_NL80211_MULTICAST_GROUP_SCAN *scanning)
+static int trigger_scan_if_necessary(struct netlink_channel *commands, struct context_NL80211_MULTICAST_GROUP_SCAN *scanning, const struct wifi_scan_params *params)
 {
 	if(!scanning->new_scan_results && !scanning->scan_triggered)
-		if(trigger_scan(commands) == -1)
+		if(trigger_scan(commands, params) == -1)
 			return -1; //most likely errno set to EBUSY which means hardware is doing something else, try again later
 	return 0;
 }
 
-// prerequisities:
-// - channel initialized with init_netlink_channel
-static int trigger_scan(struct netlink_channel *channel)
+// the limits keep the message well within the channel buffer,
+// what the device itself can take is checked by the kernel
+static int valid_scan_params(const struct wifi_scan_params *params)
 {
-	struct nlmsghdr *nlh=prepare_nl_message(channel->nl80211_id, NLM_F_REQUEST  | NLM_F_ACK, NL80211_CMD_TRIGGER_SCAN, channel);
-	mnl_attr_put_u32(nlh,  NL80211_ATTR_IFINDEX, channel->ifindex);
-	send_nl_message(nlh, channel);
-	return receive_nl_message(channel, handle_NL80211_CMD_NEW_SCAN_RESULTS);
+	int i;
+
+	if(params->frequencies_length < 0 || params->frequencies_length > WIFI_SCAN_MAX_FREQUENCIES)
+		return 0;
+	if(params->frequencies_length > 0 && params->frequencies == NULL)
+		return 0;
+	if(params->ssids_length < 0 || params->ssids_length > WIFI_SCAN_MAX_SSIDS)
+		return 0;
+	if(params->ssids_length > 0 && params->ssids == NULL)
+		return 0;
+	for(i=0; i < params->ssids_length; ++i)
+		if(params->ssids[i] == NULL || strlen(params->ssids[i]) >= SSID_MAX_LENGTH_WITH_NULL)
+			return 0;
+
+	return params->dwell_ms >= 0 && params->timeout_ms >= 0;
 }
 
-// prerequisities
-// - channel initalized with init_netlink_channel
-// - subscribed to scan group with subscribe_NL80211_MULTICAST_GROUP_SCAN
-// - context_NL80211_MULTICAST_GROUP_SCAN set for notifications
-static void wait_for_new_scan_results(struct netlink_channel *notifications)
+// prerequisities:
+// - channel initialized with init_netlink_channel
+// - params NULL or checked with valid_scan_params
+static int trigger_scan(struct netlink_channel *channel, const struct wifi_scan_params *params)
 {
-	struct context_NL80211_MULTICAST_GROUP_SCAN *scanning=notifications->context;
+	uint32_t flags = params ? params->flags : 0;
+	int dwell_ms = params ? params->dwell_ms : 0;
 	int ret;
 
-	while(!scanning->new_scan_results)
+	//flags and dwell time are only wishes, if the driver refuses them in spite of what it claims scan without them
+	while( (ret = send_trigger_scan(channel, params, flags, dwell_ms)) == -1 )
 	{
-		if ( (ret = mnl_socket_recvfrom(notifications->nl, notifications->buf, MNL_SOCKET_BUFFER_SIZE)) <=0 )
-			die_errno("Waiting for new scan results failed - mnl_socket_recvfrom");
-
-		if ( (ret=mnl_cb_run(notifications->buf, ret, 0, 0, handle_NL80211_MULTICAST_GROUP_SCAN, notifications)) <=0 )
-			die_errno("Processing notificatoins failed - mnl_cb_run");
+		if(flags != 0 && (errno == EOPNOTSUPP || errno == EINVAL))
+			flags = 0;
+		else if(dwell_ms > 0 && errno == EOPNOTSUPP)
+			dwell_ms = 0;
+		else
+			break;
 	}
-}
 
-// SCANNING - scan related
+	return ret;
+}
 
 // prerequisities:
-// - channel initalized with init_netlink_channel
-// - channel context of type context_NL80211_CMD_NEW_SCAN_RESULTS
-static int get_scan(struct netlink_channel *channel)
+// - channel initialized with init_netlink_channel
+// - params NULL or checked with valid_scan_params
+static int send_trigger_scan(struct netlink_channel *channel, const struct wifi_scan_params *params, uint32_t flags, int dwell_ms)
 {
-	struct nlmsghdr *nlh=prepare_nl_message(channel->nl80211_id, NLM_F_REQUEST | NLM_F_DUMP | NLM_F_ACK, NL80211_CMD_GET_SCAN, channel);
+	struct nlmsghdr *nlh=prepare_nl_message(channel->nl80211_id, NLM_F_REQUEST  | NLM_F_ACK, NL80211_CMD_TRIGGER_SCAN, channel);
 	mnl_attr_put_u32(nlh,  NL80211_ATTR_IFINDEX, channel->ifindex);
 
-	send_nl_message(nlh, channel);
-	return receive_nl_message(channel, handle_NL80211_CMD_NEW_SCAN_RESULTS);
+	if(params != NULL)
+	{
+		if(params->frequencies_length > 0)
+			put_NL80211_ATTR_SCAN_FREQUENCIES(nlh, params->frequencies, params->frequencies_length);
+		if(params->ssids_length > 0)
+			put_NL80211_ATTR_SCAN_SSIDS(nlh, params->ssids, params->ssids_length);
+	}
+	if(dwell_ms > 0)
+	{
+		//in TUs of 1024 us
+		uint32_t tu = (uint32_t)dwell_ms * 1000 / 1024;
+		mnl_attr_put_u16(nlh, NL80211_ATTR_MEASUREMENT_DURATION, tu == 0 ? 1 : tu > UINT16_MAX ? UINT16_MAX : tu);
+	}
+	//enum wifi_scan_flags are NL80211_SCAN_FLAG_* bits
+	if(flags != 0)
+		mnl_attr_put_u32(nlh, NL80211_ATTR_SCAN_FLAGS, flags);
+
+	if(send_nl_message(nlh, channel) == -1)
+		return -1;
+	return receive_nl_message(channel, handle_NL80211_CMD_NEW_SCAN_RESULTS);
+}
+
+// the kernel reads the nested attributes in order and does not care for their types, use the index
+static void put_NL80211_ATTR_SCAN_FREQUENCIES(struct nlmsghdr *nlh, const uint32_t *frequencies, int frequencies_length)
+{
+	struct nlattr *nested = mnl_attr_nest_start(nlh, NL80211_ATTR_SCAN_FREQUENCIES);
+	int i;
+
+	for(i=0; i < frequencies_length; ++i)
+		mnl_attr_put_u32(nlh, i+1, frequencies[i]);
+
+	mnl_attr_nest_end(nlh, nested);
+}
+
+// as above, the SSID goes without null character, empty SSID is the wildcard
+static void put_NL80211_ATTR_SCAN_SSIDS(struct nlmsghdr *nlh, const char * const *ssids, int ssids_length)
+{
+	struct nlattr *nested = mnl_attr_nest_start(nlh, NL80211_ATTR_SCAN_SSIDS);
+	int i;
+
+	for(i=0; i < ssids_length; ++i)
+		mnl_attr_put(nlh, i+1, strlen(ssids[i]), ssids[i]);
+
+	mnl_attr_nest_end(nlh, nested);
+}
+
+// prerequisities:
+// - wifi initialized with wifi_scan_init
+// - scan triggered
+static int wait_for_scan(struct wifi_scan *wifi, int timeout_ms)
+{
+	int error;
+
+	if(wait_for_new_scan_results(&wifi->notification_channel, timeout_ms) == 0)
+		return 0;
+
+	//free the radio, the NL80211_CMD_SCAN_ABORTED that follows is cleared by the next trigger
+	error = errno;
+	if(error == ETIMEDOUT)
+		abort_scan(&wifi->command_channel);
+
+	reset_scanning(&wifi->scanning);
+	errno = error;
+	return -1;
+}
+
+// prerequisities
+// - channel initalized with init_netlink_channel
+// - subscribed to scan group with subscribe_NL80211_MULTICAST_GROUP_SCAN
+// - context_NL80211_MULTICAST_GROUP_SCAN set for notifications
+static int wait_for_new_scan_results(struct netlink_channel *notifications, int timeout_ms)
+{
+	struct context_NL80211_MULTICAST_GROUP_SCAN *scanning=notifications->context;
+	struct pollfd pfd = {mnl_socket_get_fd(notifications->nl), POLLIN, 0};
+	uint64_t deadline_ms = monotonic_ms() + timeout_ms;
+
+	while(!scanning->new_scan_results)
+	{
+		uint64_t now = monotonic_ms();
+
+		if(scanning->scan_aborted)
+		{
+			errno = ECANCELED;
+			return -1;
+		}
+		if(now >= deadline_ms)
+		{
+			errno = ETIMEDOUT;
+			return -1;
+		}
+
+		if ( poll(&pfd, 1, deadline_ms - now) == -1 && errno != EINTR )
+			return -1;
+
+		if(read_past_notifications(notifications) == -1)
+			return -1;
+	}
+
+	return 0;
+}
+
+// prerequisities:
+// - channel initialized with init_netlink_channel
+static int abort_scan(struct netlink_channel *channel)
+{
+	struct nlmsghdr *nlh=prepare_nl_message(channel->nl80211_id, NLM_F_REQUEST | NLM_F_ACK, NL80211_CMD_ABORT_SCAN, channel);
+	mnl_attr_put_u32(nlh,  NL80211_ATTR_IFINDEX, channel->ifindex);
+
+	if(send_nl_message(nlh, channel) == -1)
+		return -1;
+	return receive_nl_message(channel, handle_NL80211_CMD_NEW_SCAN_RESULTS); //only the ack, ENOENT if no scan
+}
+
+// SCANNING - device features
+
+// prerequisities:
+// - wifi initialized with wifi_scan_init
+static const struct context_NL80211_CMD_NEW_WIPHY *get_wiphy_features(struct wifi_scan *wifi)
+{
+	struct netlink_channel *commands=&wifi->command_channel;
+
+	if(wifi->wiphy.queried)
+		return &wifi->wiphy;
+
+	wifi->wiphy.queried = 1;
+	commands->context=&wifi->wiphy;
+
+	//nothing is known to be supported then, so nothing is asked for
+	if(get_wiphy(commands) == -1)
+	{
+		perror("Unable to get wiphy features, scanning without flags");
+		wifi->wiphy.scan_flags = 0;
+		wifi->wiphy.scan_dwell = 0;
+		wifi->wiphy.frequencies_length = 0;
+	}
+
+	return &wifi->wiphy;
+}
+
+// prerequisities:
+// - channel initalized with init_netlink_channel
+// - channel context of type context_NL80211_CMD_NEW_WIPHY
+static int get_wiphy(struct netlink_channel *channel)
+{
+	//split dump of just our wiphy, the whole information doesn't fit in one message for newer devices
+	struct nlmsghdr *nlh=prepare_nl_message(channel->nl80211_id, NLM_F_REQUEST | NLM_F_DUMP | NLM_F_ACK, NL80211_CMD_GET_WIPHY, channel);
+	mnl_attr_put_u32(nlh,  NL80211_ATTR_IFINDEX, channel->ifindex);
+	mnl_attr_put(nlh, NL80211_ATTR_SPLIT_WIPHY_DUMP, 0, NULL);
+
+	if(send_nl_message(nlh, channel) == -1)
+		return -1;
+	return receive_nl_message(channel, handle_NL80211_CMD_NEW_WIPHY);
+}
+
+// prerequisities:
+// - netlink_channel passed as data
+// - data->context of type context_NL80211_CMD_NEW_WIPHY
+static int handle_NL80211_CMD_NEW_WIPHY(const struct nlmsghdr *nlh, void *data)
+{
+	struct netlink_channel *channel=data;
+	struct context_NL80211_CMD_NEW_WIPHY *wiphy=channel->context;
+	struct nlattr *tb[NL80211_ATTR_MAX+1] = {};
+	struct validation_data vd={tb, NL80211_ATTR_MAX, NL80211_NEW_WIPHY_VALIDATION, NL80211_NEW_WIPHY_VALIDATION_LENGTH};
+	struct genlmsghdr *genl = (struct genlmsghdr *)mnl_nlmsg_get_payload(nlh);
+
+	if(genl->cmd != NL80211_CMD_NEW_WIPHY)
+	{
+		fprintf(stderr, "Ignoring generic netlink command %u seq %u pid  %u genl cmd %u\n", nlh->nlmsg_type, nlh->nlmsg_seq, nlh->nlmsg_pid, genl->cmd);
+		return MNL_CB_OK;
+	}
+
+	mnl_attr_parse(nlh, sizeof(*genl), validate, &vd);
+
+	//each attribute comes in one of the parts
+	if(tb[NL80211_ATTR_FEATURE_FLAGS])
+	{
+		uint32_t features=mnl_attr_get_u32(tb[NL80211_ATTR_FEATURE_FLAGS]);
+
+		if(features & NL80211_FEATURE_LOW_PRIORITY_SCAN)
+			wiphy->scan_flags |= WIFI_SCAN_LOW_PRIORITY;
+		if(features & NL80211_FEATURE_SCAN_FLUSH)
+			wiphy->scan_flags |= WIFI_SCAN_FLUSH;
+	}
+
+	if(tb[NL80211_ATTR_EXT_FEATURES])
+	{
+		if(ext_feature_isset(tb[NL80211_ATTR_EXT_FEATURES], NL80211_EXT_FEATURE_LOW_SPAN_SCAN))
+			wiphy->scan_flags |= WIFI_SCAN_LOW_SPAN;
+		if(ext_feature_isset(tb[NL80211_ATTR_EXT_FEATURES], NL80211_EXT_FEATURE_LOW_POWER_SCAN))
+			wiphy->scan_flags |= WIFI_SCAN_LOW_POWER;
+		if(ext_feature_isset(tb[NL80211_ATTR_EXT_FEATURES], NL80211_EXT_FEATURE_HIGH_ACCURACY_SCAN))
+			wiphy->scan_flags |= WIFI_SCAN_HIGH_ACCURACY;
+		if(ext_feature_isset(tb[NL80211_ATTR_EXT_FEATURES], NL80211_EXT_FEATURE_SET_SCAN_DWELL))
+			wiphy->scan_dwell = 1;
+	}
+
+	if(tb[NL80211_ATTR_WIPHY_BANDS])
+		parse_NL80211_ATTR_WIPHY_BANDS(tb[NL80211_ATTR_WIPHY_BANDS], wiphy);
+
+	return MNL_CB_OK;
+}
+
+// the bitmap has bit ext_feature % 8 of byte ext_feature / 8 set for supported features
+static int ext_feature_isset(struct nlattr *attr, int ext_feature)
+{
+	const uint8_t *bitmap=mnl_attr_get_payload(attr);
+	int len=mnl_attr_get_payload_len(attr);
+
+	if(ext_feature / 8 >= len)
+		return 0;
+
+	return (bitmap[ext_feature / 8] >> (ext_feature % 8)) & 1;
+}
+
+// the bands come in parts of the split dump, a band may even be split between two of them
+static void parse_NL80211_ATTR_WIPHY_BANDS(struct nlattr *nested, struct context_NL80211_CMD_NEW_WIPHY *wiphy)
+{
+	struct nlattr *pos;
+
+	mnl_attr_for_each_nested(pos, nested)
+	{
+		struct nlattr *tb[NL80211_BAND_ATTR_MAX+1] = {};
+		struct validation_data vd={tb, NL80211_BAND_ATTR_MAX, NL80211_BAND_VALIDATION, NL80211_BAND_VALIDATION_LENGTH};
+
+		mnl_attr_parse_nested(pos, validate, &vd);
+
+		if(tb[NL80211_BAND_ATTR_FREQS])
+			parse_NL80211_BAND_ATTR_FREQS(tb[NL80211_BAND_ATTR_FREQS], wiphy);
+	}
+}
+
+static void parse_NL80211_BAND_ATTR_FREQS(struct nlattr *nested, struct context_NL80211_CMD_NEW_WIPHY *wiphy)
+{
+	struct nlattr *pos;
+
+	mnl_attr_for_each_nested(pos, nested)
+	{
+		struct nlattr *tb[NL80211_FREQUENCY_ATTR_MAX+1] = {};
+		struct validation_data vd={tb, NL80211_FREQUENCY_ATTR_MAX, NL80211_FREQUENCY_VALIDATION, NL80211_FREQUENCY_VALIDATION_LENGTH};
+		uint32_t frequency;
+		int i;
+
+		mnl_attr_parse_nested(pos, validate, &vd);
+
+		//disabled by regulatory rules, the kernel would refuse a scan with it
+		if(!tb[NL80211_FREQUENCY_ATTR_FREQ] || tb[NL80211_FREQUENCY_ATTR_DISABLED])
+			continue;
+
+		frequency = mnl_attr_get_u32(tb[NL80211_FREQUENCY_ATTR_FREQ]);
+
+		for(i=0; i < wiphy->frequencies_length && wiphy->frequencies[i] != frequency; ++i)
+			;
+		if(i == wiphy->frequencies_length && i < WIFI_SCAN_MAX_FREQUENCIES)
+			wiphy->frequencies[wiphy->frequencies_length++] = frequency;
+	}
+}
+
+// SCANNING - scan related
+
+// prerequisities:
+// - channel initalized with init_netlink_channel
+// - channel context of type context_NL80211_CMD_NEW_SCAN_RESULTS
+static int get_scan(struct netlink_channel *channel)
+{
+	struct nlmsghdr *nlh=prepare_nl_message(channel->nl80211_id, NLM_F_REQUEST | NLM_F_DUMP | NLM_F_ACK, NL80211_CMD_GET_SCAN, channel);
+	mnl_attr_put_u32(nlh,  NL80211_ATTR_IFINDEX, channel->ifindex);
+
+	if(send_nl_message(nlh, channel) == -1)
+		return -1;
+	return receive_nl_message(channel, handle_NL80211_CMD_NEW_SCAN_RESULTS);
 }
 
 // prerequisities:
@@ -628,48 +1369,97 @@ static void parse_NL80211_ATTR_BSS(struct nlattr *nested, struct netlink_channel
 	struct nlattr *tb[NL80211_BSS_MAX+1] = {};
 	struct validation_data vd={tb, NL80211_BSS_MAX, NL80211_BSS_VALIDATION, NL80211_BSS_VALIDATION_LENGTH};
 	struct context_NL80211_CMD_NEW_SCAN_RESULTS *scan_results = channel->context;
-	struct bss_info *bss = scan_results->bss_infos + scan_results->scanned;
+	struct bss_info bss = {};
 
 	mnl_attr_parse_nested(nested, validate, &vd);
 
-	enum nl80211_bss_status status=BSS_NONE;
+	bss.status=BSS_NONE;
 
 	if(tb[NL80211_BSS_STATUS])
-		status=mnl_attr_get_u32(tb[NL80211_BSS_STATUS]);
+		bss.status=mnl_attr_get_u32(tb[NL80211_BSS_STATUS]);
+
+	if ( tb[NL80211_BSS_BSSID])
+		parse_NL80211_BSS_BSSID(tb[NL80211_BSS_BSSID], bss.bssid);
+
+	if ( tb[NL80211_BSS_FREQUENCY])
+		bss.frequency = mnl_attr_get_u32(tb[NL80211_BSS_FREQUENCY]);
+
+	if ( tb[NL80211_BSS_INFORMATION_ELEMENTS])
+		parse_NL80211_BSS_INFORMATION_ELEMENTS(tb[NL80211_BSS_INFORMATION_ELEMENTS], bss.ssid);
+
+	if ( tb[NL80211_BSS_SIGNAL_MBM])
+		bss.signal_mbm=mnl_attr_get_u32(tb[NL80211_BSS_SIGNAL_MBM]);
+
+	if ( tb[NL80211_BSS_SEEN_MS_AGO])
+		bss.seen_ms_ago = mnl_attr_get_u32(tb[NL80211_BSS_SEEN_MS_AGO]);
+
+	//too old to be of use
+	if(scan_results->max_age_ms > 0 && bss.seen_ms_ago > scan_results->max_age_ms)
+		return;
+
+	++scan_results->scanned;
+	scan_results->callback(&bss, scan_results->data);
+}
+
+static int bss_associated(const struct bss_info *bss)
+{
+	return bss->status==BSS_ASSOCIATED || bss->status==BSS_IBSS_JOINED;
+}
+
+// prerequisities:
+// - data of type struct bss_array
+static void store_bss_array(const struct bss_info *bss, void *data)
+{
+	struct bss_array *array = data;
+	struct bss_info *slot = array->bss_infos + array->scanned;
 
 	//if we have found associated station store first as last and associated as first
-	if(status==NL80211_BSS_STATUS_ASSOCIATED || status==NL80211_BSS_STATUS_ASSOCIATED || status==NL80211_BSS_STATUS_IBSS_JOINED)
+	if(bss_associated(bss))
 	{
-		if(scan_results->scanned>0 && scan_results->scanned < scan_results->bss_infos_length)
-			memcpy(bss, scan_results->bss_infos, sizeof(struct bss_info));
-		bss=scan_results->bss_infos;
+		if(array->scanned>0 && array->scanned < array->bss_infos_length)
+			memcpy(slot, array->bss_infos, sizeof(struct bss_info));
+		slot=array->bss_infos;
 	}
 
 	//check bounds, make exception if we have found associated station and replace previous data
-	if(scan_results->bss_infos_length == 0 || ( scan_results->scanned >= scan_results->bss_infos_length && bss != scan_results->bss_infos ) )
+	if(array->bss_infos_length == 0 || ( array->scanned >= array->bss_infos_length && slot != array->bss_infos ) )
 	{
-		++scan_results->scanned;
+		++array->scanned;
 		return;
 	}
 
-	if ( tb[NL80211_BSS_BSSID])
-		parse_NL80211_BSS_BSSID(tb[NL80211_BSS_BSSID], bss->bssid);
-
-	if ( tb[NL80211_BSS_FREQUENCY])
-		bss->frequency = mnl_attr_get_u32(tb[NL80211_BSS_FREQUENCY]);
-
-	if ( tb[NL80211_BSS_INFORMATION_ELEMENTS])
-		parse_NL80211_BSS_INFORMATION_ELEMENTS(tb[NL80211_BSS_INFORMATION_ELEMENTS], bss->ssid);
+	memcpy(slot, bss, sizeof(struct bss_info));
+	++array->scanned;
+}
 
-	if ( tb[NL80211_BSS_SIGNAL_MBM])
-		bss->signal_mbm=mnl_attr_get_u32(tb[NL80211_BSS_SIGNAL_MBM]);
+// prerequisities:
+// - data of type struct bss_list
+static void store_bss_list(const struct bss_info *bss, void *data)
+{
+	struct bss_list *list = data;
 
-	if ( tb[NL80211_BSS_SEEN_MS_AGO])
-		bss->seen_ms_ago = mnl_attr_get_u32(tb[NL80211_BSS_SEEN_MS_AGO]);
+	if(list->length == list->size)
+	{
+		int size = list->size ? 2 * list->size : 64;
+		struct bss_info *grown = (struct bss_info *)realloc(list->bss, size * sizeof(struct bss_info));
 
-	bss->status=status;
+		if(grown == NULL)
+		{
+			fprintf(stderr, "Insufficient memory for scan results, ignoring BSS\n");
+			return;
+		}
+		list->bss = grown;
+		list->size = size;
+	}
 
-	++scan_results->scanned;
+	//as with arrays, the associated station goes first
+	list->bss[list->length] = *bss;
+	if(bss_associated(bss) && list->length > 0)
+	{
+		list->bss[list->length] = list->bss[0];
+		list->bss[0] = *bss;
+	}
+	++list->length;
 }
 
 //This is guesswork! Read up on that!!! I don't think it's netlink in this attribute, some lower beacon layer
@@ -703,6 +1493,431 @@ static void parse_NL80211_BSS_BSSID(struct nlattr *attr, uint8_t bssid_out[BSSID
 	memcpy(bssid_out, payload, BSSID_LENGTH);
 }
 
+// ROLLING SCAN
+
+// public interface
+//
+// prerequisities:
+// - wifi initialized with wifi_scan_init
+// - params NULL or filled as described in wifi_scan.h, valid until wifi_scan_rolling_close
+struct wifi_scan_rolling *wifi_scan_rolling_init(struct wifi_scan *wifi, const struct wifi_scan_params *params, int group_size)
+{
+	struct wifi_scan_rolling *rolling = (struct wifi_scan_rolling *)calloc(1, sizeof(struct wifi_scan_rolling));
+	unsigned int i;
+	int j;
+
+	if(rolling==NULL)
+		die("Insufficient memory - calloc(sizeof(struct wifi_scan_rolling)");
+
+	rolling->wifi = wifi;
+	if(params != NULL)
+		rolling->params = *params;
+	rolling->group_size = group_size > 0 ? group_size : WIFI_SCAN_ROLLING_GROUP;
+
+	//the frequencies asked for...
+	for(j=0; j < rolling->params.frequencies_length && j < WIFI_SCAN_MAX_FREQUENCIES; ++j)
+		rolling->channels[rolling->channels_length++].frequency = rolling->params.frequencies[j];
+
+	//...or the band plan without what the device can't use, if the kernel tells
+	if(rolling->channels_length == 0)
+	{
+		const struct context_NL80211_CMD_NEW_WIPHY *wiphy = get_wiphy_features(wifi);
+
+		for(i=0; i < WIFI_NCHAN; ++i)
+		{
+			uint32_t frequency = wifi_channel[i].freq_mhz;
+
+			for(j=0; j < wiphy->frequencies_length && wiphy->frequencies[j] != frequency; ++j)
+				;
+			if(wiphy->frequencies_length == 0 || j < wiphy->frequencies_length)
+				rolling->channels[rolling->channels_length++].frequency = frequency;
+		}
+	}
+
+	//no channels left means full sweeps, only merged
+	rolling->params.frequencies = rolling->group;
+	rolling->params.frequencies_length = 0;
+
+	return rolling;
+}
+
+// public interface
+//
+// prerequisities:
+// - rolling initialized with wifi_scan_rolling_init
+int wifi_scan_rolling_trigger(struct wifi_scan_rolling *rolling)
+{
+	struct wifi_scan *wifi = rolling->wifi;
+	uint64_t now = monotonic_ms();
+	int ours;
+
+	//somebody else's scan is collected instead of triggering ours, it tells nothing about the group
+	if(read_past_notifications(&wifi->notification_channel) == -1)
+		return -1;
+	ours = wifi->scanning.scan_aborted || (!wifi->scanning.new_scan_results && !wifi->scanning.scan_triggered);
+
+	pick_rolling_group(rolling, now);
+
+	if(wifi_scan_trigger_params(wifi, &rolling->params) == -1)
+	{
+		clear_rolling_group(rolling);
+		return -1; //most likely with errno set to EBUSY
+	}
+
+	if(!ours)
+		clear_rolling_group(rolling);
+
+	return 0;
+}
+
+// public interface
+//
+// prerequisities:
+// - rolling initialized with wifi_scan_rolling_init
+// - list zeroed or filled before by the library
+int wifi_scan_rolling_results(struct wifi_scan_rolling *rolling, struct bss_list *list)
+{
+	int i;
+
+	rolling->now_ms = monotonic_ms();
+
+	if(get_scan_results(rolling->wifi, merge_rolling_bss, rolling) == -1)
+		return -1;
+
+	end_rolling_merge(rolling);
+
+	list->length = 0;
+	for(i=0; i < rolling->view_length; ++i)
+	{
+		struct bss_info bss = rolling->view[i].bss;
+
+		bss.seen_ms_ago = rolling->now_ms - rolling->view[i].seen_ms;
+		store_bss_list(&bss, list);
+	}
+
+	return list->length;
+}
+
+// public interface
+void wifi_scan_rolling_close(struct wifi_scan_rolling *rolling)
+{
+	free(rolling->view);
+	free(rolling);
+}
+
+// the longer a channel waited the sooner it comes, a channel with BSSes waits a third
+// of what an empty one does and every change of late shortens the wait further
+static void pick_rolling_group(struct wifi_scan_rolling *rolling, uint64_t now_ms)
+{
+	int i, n;
+
+	clear_rolling_group(rolling);
+
+	for(n=0; n < rolling->group_size && n < rolling->channels_length; ++n)
+	{
+		struct rolling_channel *best = NULL;
+		uint64_t best_score = 0;
+
+		for(i=0; i < rolling->channels_length; ++i)
+		{
+			struct rolling_channel *channel = rolling->channels + i;
+			uint64_t score;
+
+			if(channel->in_group)
+				continue;
+
+			//never scanned go first, in the order of the band plan
+			if(channel->scanned_ms == 0)
+				score = UINT64_MAX;
+			else
+				score = (now_ms - channel->scanned_ms + 1) * (1 + (channel->bss_count > 0 ? 2 : 0) + channel->changes);
+
+			if(best == NULL || score > best_score)
+			{
+				best = channel;
+				best_score = score;
+			}
+		}
+
+		best->in_group = 1;
+		rolling->group[n] = best->frequency;
+	}
+
+	rolling->params.frequencies_length = n;
+	rolling->triggered_ms = now_ms;
+}
+
+static void clear_rolling_group(struct wifi_scan_rolling *rolling)
+{
+	int i;
+
+	for(i=0; i < rolling->channels_length; ++i)
+		rolling->channels[i].in_group = 0;
+
+	rolling->triggered_ms = 0;
+}
+
+// prerequisities:
+// - data of type struct wifi_scan_rolling
+// - now_ms set for the merge
+static void merge_rolling_bss(const struct bss_info *bss, void *data)
+{
+	struct wifi_scan_rolling *rolling = data;
+	struct rolling_channel *channel = find_rolling_channel(rolling, bss->frequency);
+	uint64_t seen_ms = bss->seen_ms_ago >= 0 && (uint64_t)bss->seen_ms_ago < rolling->now_ms ? rolling->now_ms - bss->seen_ms_ago : 0;
+	struct rolling_bss *known;
+	int i;
+
+	//not found by the last scan of its channel (maybe the one just made), the kernel only remembers it
+	if(channel != NULL && seen_ms < (channel->in_group ? rolling->triggered_ms : channel->scanned_ms))
+		return;
+
+	for(i=0; i < rolling->view_length; ++i)
+		if(memcmp(rolling->view[i].bss.bssid, bss->bssid, BSSID_LENGTH) == 0)
+			break;
+
+	known = rolling->view + i;
+
+	if(i < rolling->view_length)
+	{
+		//what we have is fresher
+		if(seen_ms < known->seen_ms)
+			return;
+
+		if(known->bss.frequency != bss->frequency)
+		{
+			struct rolling_channel *moved_from = find_rolling_channel(rolling, known->bss.frequency);
+
+			if(moved_from != NULL)
+				++moved_from->merge_changes;
+			if(channel != NULL)
+				++channel->merge_changes;
+		}
+	}
+	else
+	{
+		if(rolling->view_length == rolling->view_size)
+		{
+			int size = rolling->view_size ? 2 * rolling->view_size : 64;
+			struct rolling_bss *grown = (struct rolling_bss *)realloc(rolling->view, size * sizeof(struct rolling_bss));
+
+			if(grown == NULL)
+			{
+				fprintf(stderr, "Insufficient memory for rolling scan view, ignoring BSS\n");
+				return;
+			}
+			rolling->view = grown;
+			rolling->view_size = size;
+		}
+
+		known = rolling->view + rolling->view_length++;
+		if(channel != NULL)
+			++channel->merge_changes;
+	}
+
+	known->bss = *bss;
+	known->seen_ms = seen_ms;
+}
+
+static void end_rolling_merge(struct wifi_scan_rolling *rolling)
+{
+	int i, kept;
+
+	for(i=0; i < rolling->channels_length; ++i)
+		rolling->channels[i].bss_count = 0;
+
+	for(i=kept=0; i < rolling->view_length; ++i)
+	{
+		struct rolling_bss *known = rolling->view + i;
+		struct rolling_channel *channel = find_rolling_channel(rolling, known->bss.frequency);
+
+		//gone from the channel just scanned, or not seen anywhere for too long
+		if( (channel != NULL && channel->in_group && known->seen_ms < rolling->triggered_ms) ||
+			rolling->now_ms - known->seen_ms > WIFI_SCAN_ROLLING_EXPIRE_MS )
+		{
+			if(channel != NULL)
+				++channel->merge_changes;
+			continue;
+		}
+
+		if(channel != NULL)
+			++channel->bss_count;
+		rolling->view[kept++] = *known;
+	}
+
+	rolling->view_length = kept;
+
+	for(i=0; i < rolling->channels_length; ++i)
+	{
+		struct rolling_channel *channel = rolling->channels + i;
+
+		if(channel->in_group)
+		{
+			channel->scanned_ms = rolling->triggered_ms;
+			channel->changes /= 2;
+		}
+		channel->changes += channel->merge_changes;
+		channel->merge_changes = 0;
+	}
+
+	//the results of later scans may be somebody else's
+	clear_rolling_group(rolling);
+}
+
+static struct rolling_channel *find_rolling_channel(struct wifi_scan_rolling *rolling, uint32_t frequency)
+{
+	int i;
+
+	for(i=0; i < rolling->channels_length; ++i)
+		if(rolling->channels[i].frequency == frequency)
+			return rolling->channels + i;
+
+	return NULL;
+}
+
+static uint64_t monotonic_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+
+// PACING
+
+// public interface
+void bss_diff(const struct bss_info *before, int before_length, const struct bss_info *after, int after_length, struct bss_diff *diff)
+{
+	int i;
+
+	memset(diff, 0, sizeof(struct bss_diff));
+
+	for(i=0; i < after_length; ++i)
+	{
+		const struct bss_info *was = find_bss(before, before_length, after[i].bssid);
+
+		if(was == NULL)
+			++diff->added;
+		else if(was->frequency != after[i].frequency || abs(was->signal_mbm - after[i].signal_mbm) >= WIFI_SCAN_DIFF_SIGNAL_MBM)
+			++diff->moved;
+	}
+
+	for(i=0; i < before_length; ++i)
+		if(find_bss(after, after_length, before[i].bssid) == NULL)
+			++diff->vanished;
+}
+
+// public interface
+void wifi_scan_pacing_init(struct wifi_scan_pacing *pacing, int min_interval_ms, int max_interval_ms)
+{
+	memset(pacing, 0, sizeof(struct wifi_scan_pacing));
+
+	pacing->min_interval_ms = min_interval_ms > 0 ? min_interval_ms : 1;
+	pacing->max_interval_ms = max_interval_ms > pacing->min_interval_ms ? max_interval_ms : pacing->min_interval_ms;
+	pacing->interval_ms = 2 * pacing->min_interval_ms;
+	if(pacing->interval_ms > pacing->max_interval_ms)
+		pacing->interval_ms = pacing->max_interval_ms;
+	pacing->link_factor = 1;
+}
+
+// public interface
+//
+// prerequisities:
+// - pacing initialized with wifi_scan_pacing_init
+int wifi_scan_pacing_results(struct wifi_scan_pacing *pacing, const struct bss_diff *diff, int bss_count)
+{
+	int changes = diff->added + diff->vanished + diff->moved;
+
+	//the device scans again, whatever kept it busy is over
+	pacing->backoff_ms = 0;
+
+	if(changes * 10 >= (bss_count > 0 ? bss_count : 1))
+		pacing->interval_ms /= 2;
+	else if(changes == 0)
+		pacing->interval_ms += pacing->interval_ms / 2 + 1;
+
+	if(pacing->interval_ms < pacing->min_interval_ms)
+		pacing->interval_ms = pacing->min_interval_ms;
+	if(pacing->interval_ms > pacing->max_interval_ms)
+		pacing->interval_ms = pacing->max_interval_ms;
+
+	return pacing_delay(pacing);
+}
+
+// public interface
+//
+// prerequisities:
+// - pacing initialized with wifi_scan_pacing_init
+int wifi_scan_pacing_failed(struct wifi_scan_pacing *pacing, int error)
+{
+	//busy device (or one whose scans get aborted) backs off exponentially, anything else is not going away soon
+	if(error == EBUSY || error == EAGAIN || error == ECANCELED || error == ETIMEDOUT)
+		pacing->backoff_ms = pacing->backoff_ms ? 2 * pacing->backoff_ms : pacing->min_interval_ms;
+	else
+		pacing->backoff_ms = pacing->max_interval_ms;
+
+	if(pacing->backoff_ms > pacing->max_interval_ms)
+		pacing->backoff_ms = pacing->max_interval_ms;
+
+	return pacing_delay(pacing);
+}
+
+// public interface
+//
+// prerequisities:
+// - pacing initialized with wifi_scan_pacing_init
+// - station filled by wifi_scan_station or NULL
+int wifi_scan_pacing_link(struct wifi_scan_pacing *pacing, const struct station_info *station)
+{
+	uint64_t now = monotonic_ms();
+
+	if(station == NULL || (station->status != BSS_ASSOCIATED && station->status != BSS_IBSS_JOINED))
+	{
+		pacing->link_factor = 1;
+		pacing->link_ms = 0;
+		return pacing_delay(pacing);
+	}
+
+	//the counters wrap around, unsigned difference is right anyway
+	if(pacing->link_ms != 0 && now > pacing->link_ms)
+	{
+		uint64_t packets = (uint32_t)(station->rx_packets - pacing->rx_packets) + (uint64_t)(uint32_t)(station->tx_packets - pacing->tx_packets);
+		uint64_t pps = packets * 1000 / (now - pacing->link_ms);
+
+		if(pps >= WIFI_SCAN_PACING_BUSY_PPS && pacing->link_factor < WIFI_SCAN_PACING_MAX_LINK_FACTOR)
+			pacing->link_factor *= 2;
+		else if(pps < WIFI_SCAN_PACING_BUSY_PPS && pacing->link_factor > 1)
+			pacing->link_factor /= 2;
+	}
+
+	pacing->rx_packets = station->rx_packets;
+	pacing->tx_packets = station->tx_packets;
+	pacing->link_ms = now;
+
+	return pacing_delay(pacing);
+}
+
+static int pacing_delay(const struct wifi_scan_pacing *pacing)
+{
+	int delay = pacing->interval_ms * pacing->link_factor;
+
+	if(delay < pacing->backoff_ms)
+		delay = pacing->backoff_ms;
+
+	return delay < pacing->max_interval_ms ? delay : pacing->max_interval_ms;
+}
+
+static const struct bss_info *find_bss(const struct bss_info *bss_infos, int bss_infos_length, const uint8_t bssid[BSSID_LENGTH])
+{
+	int i;
+
+	for(i=0; i < bss_infos_length; ++i)
+		if(memcmp(bss_infos[i].bssid, bssid, BSSID_LENGTH) == 0)
+			return bss_infos + i;
+
+	return NULL;
+}
+
 // STATION
 
 // public interface
@@ -714,9 +1929,11 @@ int wifi_scan_station(struct wifi_scan *wifi,struct station_info *station)
 	struct netlink_channel *commands=&wifi->command_channel;
 	struct bss_info bss;
 
-	struct context_NL80211_CMD_NEW_SCAN_RESULTS scan_results = {&bss, 1, 0};
+	struct bss_array array = {&bss, 1, 0};
+	struct context_NL80211_CMD_NEW_SCAN_RESULTS scan_results = {store_bss_array, &array, 0, 0};
 	commands->context=&scan_results;
-	get_scan(commands);
+	if(get_scan(commands) == -1)
+		return -1;
 
 	if(scan_results.scanned==0)
 		return 0;
@@ -740,7 +1957,8 @@ static int get_station(struct netlink_channel *channel, uint8_t bssid[BSSID_LENG
 	struct nlmsghdr *nlh=prepare_nl_message(channel->nl80211_id, NLM_F_REQUEST | NLM_F_ACK, NL80211_CMD_GET_STATION, channel);
 	mnl_attr_put_u32(nlh,  NL80211_ATTR_IFINDEX, channel->ifindex);
 	mnl_attr_put(nlh,  NL80211_ATTR_MAC, BSSID_LENGTH, bssid);
-	send_nl_message(nlh, channel);
+	if(send_nl_message(nlh, channel) == -1)
+		return -1;
 	return receive_nl_message(channel, handle_NL80211_CMD_NEW_STATION);
 }
 
@@ -817,10 +2035,11 @@ static struct nlmsghdr *prepare_nl_message(uint32_t type, uint16_t flags, uint8_
 // prerequisities:
 // - prepare_nl_message called first
 // - mnl_attr_put_xxx used if additional attributes needed
-static void send_nl_message(struct nlmsghdr *nlh, struct netlink_channel *channel)
+static int send_nl_message(struct nlmsghdr *nlh, struct netlink_channel *channel)
 {
 	if (mnl_socket_sendto(channel->nl, nlh, nlh->nlmsg_len) < 0)
-		die_errno("mnl_socket_sendto");
+		return -1;
+	return 0;
 }
 
 // prerequisities:
@@ -107,6 +107,8 @@ int wifi_scan_station(struct wifi_scan *wifi, struct station_info *station);
  * -1 on error (errno is set) or the number of found BSSes, the number may be greater then bss_infos_length
  *
  * Some devices may fail with -1 and errno=EBUSY if triggering scan when another scan is in progress. You may wait and retry in that case 
+ * If the results don't come in WIFI_SCAN_TIMEOUT_MS the scan is aborted and it fails with errno=ETIMEDOUT,
+ * if the scan is aborted by somebody else (or the driver) it fails with errno=ECANCELED.
  *
  * preconditions:
  * wifi initialized with wifi_scan_init
@@ -114,6 +116,283 @@ int wifi_scan_station(struct wifi_scan *wifi, struct station_info *station);
  */
 int wifi_scan_all(struct wifi_scan *wifi, struct bss_info *bss_infos, int bss_infos_length);
 
+/* Make a scan without blocking, in steps, from your own event loop (poll, epoll, select...)
+ *
+ * wifi_scan_trigger - triggers passive scan if necessary, as wifi_scan_all does, and returns at once
+ * wifi_scan_get_fd - the descriptor to wait for (POLLIN/EPOLLIN) until the scan is done
+ * wifi_scan_process - call when the descriptor is readable, never blocks
+ * wifi_scan_abort - stops the scan in progress, wifi_scan_process then fails with ECANCELED
+ * wifi_scan_results - call when wifi_scan_process returned 1, returns what wifi_scan_all would
+ *
+ * The descriptor stays the same for the life of wifi, it may be added to epoll once.
+ * Deadlines are up to the loop: when a scan takes too long (it shouldn't take WIFI_SCAN_TIMEOUT_MS), or the link
+ * needs the radio back, abort it with wifi_scan_abort.
+ * Other programs' scans are noticed as well, so wifi_scan_process may return 1 without a trigger.
+ *
+ * parameters:
+ * wifi - library data initialized with wifi_scan_init
+ * bss_infos, bss_infos_length - as in wifi_scan_all
+ *
+ * returns:
+ * wifi_scan_get_fd - the descriptor
+ * wifi_scan_trigger - -1 on error (errno is set, EBUSY when the device is doing something else), 0 otherwise
+ * wifi_scan_process - 1 if the results are ready, 0 if not yet, -1 on error (errno is set, ECANCELED if the scan was aborted)
+ * wifi_scan_abort - -1 on error (errno is set, ENOENT if no scan is in progress, the library stops waiting for one then), 0 otherwise
+ * wifi_scan_results - -1 on error (errno is set) or the number of found BSSes, the number may be greater then bss_infos_length
+ *
+ * preconditions:
+ * wifi initialized with wifi_scan_init
+ *
+ */
+enum wifi_scan_timeouts {WIFI_SCAN_TIMEOUT_MS=10000};
+
+int wifi_scan_get_fd(struct wifi_scan *wifi);
+int wifi_scan_trigger(struct wifi_scan *wifi);
+int wifi_scan_process(struct wifi_scan *wifi);
+int wifi_scan_results(struct wifi_scan *wifi, struct bss_info *bss_infos, int bss_infos_length);
+int wifi_scan_abort(struct wifi_scan *wifi);
+
+/* Get the scan results one BSS at a time, as they are parsed, or all of them in a list that grows as needed
+ *
+ * Nothing is truncated, whatever the number of BSSes.
+ *
+ * wifi_scan_results_callback - calls callback with each BSS, it may keep what it needs (the bss is only valid during the call)
+ * wifi_scan_results_list - fills list, growing it as needed; the associated station goes first as with wifi_scan_all
+ * wifi_scan_all_list - as wifi_scan_all, into list (with the same deadline)
+ * bss_list_free - frees the memory of list, it may be filled again
+ *
+ * parameters:
+ * wifi - library data initialized with wifi_scan_init
+ * callback, data - called as callback(bss, data), it must not call the library
+ * list - zeroed before the first use, e.g. struct bss_list list = {0}; reused for later scans
+ *
+ * returns:
+ * -1 on error (errno is set) or the number of found BSSes
+ *
+ * preconditions:
+ * wifi initialized with wifi_scan_init, for wifi_scan_results_* the results are ready (see wifi_scan_process)
+ *
+ */
+typedef void (*wifi_scan_callback)(const struct bss_info *bss, void *data);
+
+struct bss_list
+{
+	struct bss_info *bss; //the BSSes found
+	int length; //how many
+	int size; //room allocated, managed by the library
+};
+
+int wifi_scan_results_callback(struct wifi_scan *wifi, wifi_scan_callback callback, void *data);
+int wifi_scan_results_list(struct wifi_scan *wifi, struct bss_list *list);
+int wifi_scan_all_list(struct wifi_scan *wifi, struct bss_list *list);
+void bss_list_free(struct bss_list *list);
+
+/* Scan only some channels, probe for some networks or stay on each channel for a given time
+ *
+ * A full sweep of all the channels the device supports takes seconds, most of it away from the channel of the link.
+ * A few channels take a fraction of that. Only the BSSes on those channels are refreshed, the results
+ * (wifi_scan_results...) still have the others, as long as the kernel remembers them (see seen_ms_ago).
+ *
+ * wifi_scan_trigger_params - as wifi_scan_trigger, scanning as params say
+ * wifi_scan_all_params - as wifi_scan_all_list, scanning as params say, waiting for the results until params->timeout_ms
+ *
+ * If somebody else has triggered a scan already, its results are collected and params are not used.
+ *
+ * parameters:
+ * wifi - library data initialized with wifi_scan_init
+ * params - what to scan, NULL or zeroed for all the channels, passive, as wifi_scan_trigger
+ * list - as in wifi_scan_results_list
+ *
+ * returns:
+ * -1 on error (errno is set, EINVAL also for a frequency the device doesn't have or too many SSIDs), otherwise as
+ * wifi_scan_trigger and wifi_scan_all_list
+ *
+ * preconditions:
+ * wifi initialized with wifi_scan_init
+ *
+ */
+enum wifi_scan_limits {WIFI_SCAN_MAX_FREQUENCIES=128, WIFI_SCAN_MAX_SSIDS=16};
+
+struct wifi_scan_params
+{
+	const uint32_t *frequencies; //channels to scan in MHz (e.g. 2412 for channel 1, see wifi_chan.h), NULL for all
+	int frequencies_length; //at most WIFI_SCAN_MAX_FREQUENCIES
+	const char * const *ssids; //networks to probe for (active scan), "" for any network, NULL for passive scan
+	int ssids_length; //at most WIFI_SCAN_MAX_SSIDS, the device may take less
+	int dwell_ms; //time on each channel, 0 for the driver's choice; only a hint, left out where not supported
+	uint32_t flags; //enum wifi_scan_flags, how to trade the freshness of the results against the link, 0 for none
+	int timeout_ms; //wifi_scan_all_params gives up and aborts the scan after that, 0 for WIFI_SCAN_TIMEOUT_MS
+};
+
+int wifi_scan_trigger_params(struct wifi_scan *wifi, const struct wifi_scan_params *params);
+int wifi_scan_all_params(struct wifi_scan *wifi, const struct wifi_scan_params *params, struct bss_list *list);
+
+/* Scan with less disruption of the link, or with more accuracy, as the device allows
+ *
+ * Set flags of struct wifi_scan_params to a combination of:
+ * WIFI_SCAN_LOW_PRIORITY - the scan gives way to the traffic of the link (and may be cut short by it)
+ * WIFI_SCAN_LOW_SPAN - as few channels as would do, as quickly as possible
+ * WIFI_SCAN_LOW_POWER - spend the least power, may find less
+ * WIFI_SCAN_HIGH_ACCURACY - take the time needed to find everything
+ * WIFI_SCAN_FLUSH - forget the BSSes found before, the results are only what this scan finds
+ *
+ * Not every device can do every one of them. The flags (and dwell_ms) the device doesn't support
+ * are left out and the scan is made without them, never failed because of them.
+ *
+ * wifi_scan_supported_flags - the flags the device supports, asked from the kernel once
+ *
+ * parameters:
+ * wifi - library data initialized with wifi_scan_init
+ *
+ * returns:
+ * the supported enum wifi_scan_flags, 0 also when the kernel wouldn't tell
+ *
+ * preconditions:
+ * wifi initialized with wifi_scan_init
+ *
+ */
+// the same bits as NL80211_SCAN_FLAG_* in linux/nl80211.h
+enum wifi_scan_flags
+{
+	WIFI_SCAN_LOW_PRIORITY=1<<0,
+	WIFI_SCAN_FLUSH=1<<1,
+	WIFI_SCAN_LOW_SPAN=1<<8,
+	WIFI_SCAN_LOW_POWER=1<<9,
+	WIFI_SCAN_HIGH_ACCURACY=1<<10
+};
+
+uint32_t wifi_scan_supported_flags(struct wifi_scan *wifi);
+
+/* Get what the kernel already knows about the networks around, without a scan
+ *
+ * The kernel keeps the results of every scan, also of those of other programs (wpa_supplicant, NetworkManager...).
+ * This only reads them: it returns at once, does not disturb the link, needs no permissions
+ * and leaves a scan in progress (see wifi_scan_trigger) alone.
+ *
+ * parameters:
+ * wifi - library data initialized with wifi_scan_init
+ * bss_infos, bss_infos_length - as in wifi_scan_all
+ * list - as in wifi_scan_results_list
+ * callback, data - as in wifi_scan_results_callback
+ * max_age_ms - leave out BSSes last seen longer ago (seen_ms_ago), 0 for all of them
+ *
+ * returns:
+ * -1 on error (errno is set) or the number of BSSes, for wifi_scan_cached it may be greater then bss_infos_length
+ *
+ * preconditions:
+ * wifi initialized with wifi_scan_init
+ *
+ */
+int wifi_scan_cached(struct wifi_scan *wifi, struct bss_info *bss_infos, int bss_infos_length, int max_age_ms);
+int wifi_scan_cached_list(struct wifi_scan *wifi, struct bss_list *list, int max_age_ms);
+int wifi_scan_cached_callback(struct wifi_scan *wifi, wifi_scan_callback callback, void *data, int max_age_ms);
+
+/* Scan a few channels at a time, round after round, and keep a rolling view of all of them
+ *
+ * Instead of one long sweep, the channels of the band plan (wifi_chan.h) that the device can use are split
+ * in groups of group_size and scanned one group per scan. Each scan keeps the radio off the channel of the link
+ * only briefly and its results are merged into a view of all the channels: BSSes found are added or refreshed,
+ * BSSes gone from the channels just scanned are dropped, and anything not seen for WIFI_SCAN_ROLLING_EXPIRE_MS too.
+ *
+ * The channels are not taken strictly in turn. The longer a channel waits, the sooner it comes, and channels
+ * with BSSes, more so with BSSes coming, going or moving, wait for less than empty ones.
+ *
+ * wifi_scan_rolling_init - prepares the schedule, over params->frequencies if given or else the band plan
+ * wifi_scan_rolling_trigger - triggers the scan of the next group, as wifi_scan_trigger_params
+ * wifi_scan_rolling_results - call when wifi_scan_process returned 1, merges the results and copies the view to list
+ * wifi_scan_rolling_close - frees the resources
+ *
+ * parameters:
+ * wifi - library data initialized with wifi_scan_init
+ * params - as in wifi_scan_trigger_params, may be NULL; it (and what it points to) must stay valid until close
+ * group_size - channels per scan, 0 for WIFI_SCAN_ROLLING_GROUP
+ * rolling - returned by wifi_scan_rolling_init
+ * list - as in wifi_scan_results_list, seen_ms_ago is counted up to now for BSSes of channels not just scanned
+ *
+ * returns:
+ * wifi_scan_rolling_init - pass it to the functions above (dies on insufficient memory like wifi_scan_init)
+ * wifi_scan_rolling_trigger - -1 on error (errno is set, EBUSY when the device is doing something else), 0 otherwise
+ * wifi_scan_rolling_results - -1 on error (errno is set) or the number of BSSes in the view
+ *
+ * preconditions:
+ * wifi initialized with wifi_scan_init and not closed before rolling
+ *
+ */
+enum wifi_scan_rolling_constants {WIFI_SCAN_ROLLING_GROUP=4, WIFI_SCAN_ROLLING_EXPIRE_MS=30000};
+
+struct wifi_scan_rolling;
+
+struct wifi_scan_rolling *wifi_scan_rolling_init(struct wifi_scan *wifi, const struct wifi_scan_params *params, int group_size);
+int wifi_scan_rolling_trigger(struct wifi_scan_rolling *rolling);
+int wifi_scan_rolling_results(struct wifi_scan_rolling *rolling, struct bss_list *list);
+void wifi_scan_rolling_close(struct wifi_scan_rolling *rolling);
+
+/* Find what changed between two scans
+ *
+ * BSSes are matched by BSSID. Moved are those on another channel or with signal stronger or weaker
+ * by WIFI_SCAN_DIFF_SIGNAL_MBM or more.
+ *
+ * parameters:
+ * before, before_length - the earlier scan
+ * after, after_length - the later scan
+ * diff - filled with the counts
+ *
+ */
+enum wifi_scan_diff_constants {WIFI_SCAN_DIFF_SIGNAL_MBM=1000};
+
+struct bss_diff
+{
+	int added; //in after but not in before
+	int vanished; //in before but not in after
+	int moved; //in both, on another channel or with quite another signal
+};
+
+void bss_diff(const struct bss_info *before, int before_length, const struct bss_info *after, int after_length, struct bss_diff *diff);
+
+/* Decide when to scan next
+ *
+ * The interval between scans starts at twice min_interval_ms. It is halved when a scan finds many changes
+ * (a tenth of the BSSes or more new, vanished or moved) and grows by half when it finds none.
+ * A failed trigger (EBUSY most often) or a scan aborted or timed out waits min_interval_ms, then twice as long after every next failure,
+ * until a scan succeeds. Heavy traffic on the link (WIFI_SCAN_PACING_BUSY_PPS packets a second or more,
+ * from the counters of wifi_scan_station) doubles the interval, up to WIFI_SCAN_PACING_MAX_LINK_FACTOR times.
+ * Nothing waits longer than max_interval_ms.
+ *
+ * wifi_scan_pacing_init - sets the bounds, no scan was made yet
+ * wifi_scan_pacing_results - call with the diff (see bss_diff) of the last two scans and the number of BSSes
+ * wifi_scan_pacing_failed - call when a trigger failed
+ * wifi_scan_pacing_link - call with wifi_scan_station data whenever (e.g. after every scan)
+ *
+ * parameters:
+ * pacing - the state, owned by the caller
+ * min_interval_ms, max_interval_ms - the bounds of the time between scans
+ * diff, bss_count - what the last scan found
+ * error - errno of the failed trigger
+ * station - as filled by wifi_scan_station, NULL if it returned 0 or -1
+ *
+ * returns:
+ * the time to wait before the next trigger, in ms
+ *
+ */
+enum wifi_scan_pacing_constants {WIFI_SCAN_PACING_BUSY_PPS=200, WIFI_SCAN_PACING_MAX_LINK_FACTOR=8};
+
+struct wifi_scan_pacing
+{
+	int min_interval_ms;
+	int max_interval_ms;
+	int interval_ms; //from the changes
+	int backoff_ms; //after failed triggers, 0 for none
+	int link_factor; //from the traffic on the link, 1 for none
+	uint32_t rx_packets; //link counters last time
+	uint32_t tx_packets;
+	uint64_t link_ms; //when they were read, 0 for never
+};
+
+void wifi_scan_pacing_init(struct wifi_scan_pacing *pacing, int min_interval_ms, int max_interval_ms);
+int wifi_scan_pacing_results(struct wifi_scan_pacing *pacing, const struct bss_diff *diff, int bss_count);
+int wifi_scan_pacing_failed(struct wifi_scan_pacing *pacing, int error);
+int wifi_scan_pacing_link(struct wifi_scan_pacing *pacing, const struct station_info *station);
+
 #ifdef __cplusplus
 }
 #endif
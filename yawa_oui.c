@@ -0,0 +1,496 @@
+/*
+ *
+ * MAC to vendor in bulk, e.g. for DHCP and RADIUS logs
+ *
+ * Usage: yawa-oui [-a] [-s] [-j threads] [-v vendors] [-l local-vendors] [file ...]
+ *
+ * Reads the files, or stdin if there are none or a file is "-", and prints
+ * the vendor of the first MAC on every line as
+ *
+ *	aa:bb:cc:dd:ee:ff<TAB>vendor
+ *
+ * The MAC may be in any notation mac_parse() knows: colons, dashes, Cisco's
+ * dotted quads or bare hex, in either case. Lines without a MAC are left out.
+ * With -a every line is printed as it was, followed by a tab and the vendor
+ * if it has a MAC, to annotate a log in place; a \r\n line ending is kept,
+ * with the vendor before the \r.
+ *
+ * The vendors are the table built into the program, or the CSV or image
+ * given with -v; a table given with -l is consulted first (see
+ * vendor_db_lookup()). -s prints the counts and the rate to stderr.
+ * A file that cannot be opened or read is skipped, and makes the exit
+ * status 1 at the end.
+ *
+ * The main thread cuts the input at line ends into blocks of OUI_BLOCK
+ * bytes, or less if no more is there yet. A pool of worker threads takes
+ * the blocks in turn: each finds the MACs of its block, resolves them in one
+ * vendor_db_lookup_macs() call and formats its output, which a writer thread
+ * writes in input order. The tables are shared by all of them, read-only.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "get_mac_table.h"
+
+#define OUI_BLOCK	(1 << 20)	/* input per job */
+#define OUI_MAX_THREADS	64
+#define OUI_JOBS_PER_THREAD 2		/* so the workers need not wait for the I/O */
+
+struct oui_line {
+	size_t off, len;	/* of the line in the block, without the newline */
+	long mac;		/* index into macs[], -1 for none */
+	int cr;			/* len leaves out the \r of a \r\n */
+};
+
+struct oui_job {
+	char *in;
+	size_t in_len, in_size;
+
+	struct oui_line *lines;
+	size_t n_lines, lines_size, n_input;	/* lines printed, read */
+
+	uint8_t (*macs)[6];
+	const char **vendors;
+	size_t *lens;
+	size_t n_macs, macs_size, found;
+
+	char *out;
+	size_t out_len, out_size;
+
+	enum { JOB_EMPTY, JOB_FILLED, JOB_DONE } state;
+};
+
+static struct oui_job *jobs;
+static size_t n_jobs;
+static size_t jobs_filled, jobs_taken;		/* sequence numbers */
+static int jobs_end;
+static pthread_mutex_t jobs_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t jobs_work = PTHREAD_COND_INITIALIZER;	/* a job was filled */
+static pthread_cond_t jobs_state = PTHREAD_COND_INITIALIZER;	/* one was done or written */
+
+static size_t total_lines, total_macs, total_found;
+
+static const struct vendor_db *dbs[2];
+static size_t n_dbs;
+static int annotate;
+
+static void *xrealloc(void *p, size_t size)
+{
+	if (!(p = realloc(p, size))) {
+		perror("realloc");
+		exit(1);
+	}
+	return p;
+}
+
+static inline uint64_t clock_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * The workers
+ */
+
+static void job_find_macs(struct oui_job *job)
+{
+	const char *p = job->in, *end = job->in + job->in_len;
+
+	job->n_lines = job->n_macs = job->n_input = 0;
+
+	while (p < end) {
+		const char *nl = memchr(p, '\n', end - p);
+		size_t len = (nl ? nl : end) - p;
+		struct oui_line *line;
+		long mac = -1;
+
+		if (job->n_macs == job->macs_size) {
+			job->macs_size = job->macs_size ? 2 * job->macs_size : 4096;
+			job->macs = xrealloc(job->macs, job->macs_size * sizeof(*job->macs));
+		}
+		if (mac_find(p, len, job->macs[job->n_macs], NULL))
+			mac = job->n_macs++;
+
+		if (mac >= 0 || annotate) {
+			if (job->n_lines == job->lines_size) {
+				job->lines_size = job->lines_size ? 2 * job->lines_size : 4096;
+				job->lines = xrealloc(job->lines, job->lines_size * sizeof(*job->lines));
+			}
+			line = &job->lines[job->n_lines++];
+			line->cr = len > 0 && p[len - 1] == '\r';
+			line->off = p - job->in;
+			line->len = len - line->cr;
+			line->mac = mac;
+		}
+
+		job->n_input++;
+		p += len + 1;
+	}
+}
+
+static inline char *put_mac(char *q, const uint8_t mac[6])
+{
+	static const char hex[] = "0123456789abcdef";
+
+	for (int i = 0; i < 6; i++) {
+		*q++ = hex[mac[i] >> 4];
+		*q++ = hex[mac[i] & 0xf];
+		*q++ = ':';
+	}
+	return q - 1;
+}
+
+static void job_format(struct oui_job *job)
+{
+	job->out_len = 0;
+
+	for (size_t i = 0; i < job->n_lines; i++) {
+		const struct oui_line *line = &job->lines[i];
+		size_t need = (annotate ? line->len + line->cr : 17) + 2;
+		char *q;
+
+		if (line->mac >= 0)
+			need += job->lens[line->mac] + 1;
+		if (job->out_len + need > job->out_size) {
+			job->out_size = 2 * (job->out_len + need);
+			job->out = xrealloc(job->out, job->out_size);
+		}
+		q = job->out + job->out_len;
+
+		if (annotate) {
+			memcpy(q, job->in + line->off, line->len);
+			q += line->len;
+		} else
+			q = put_mac(q, job->macs[line->mac]);
+
+		if (line->mac >= 0) {
+			*q++ = '\t';
+			memcpy(q, job->vendors[line->mac], job->lens[line->mac]);
+			q += job->lens[line->mac];
+		}
+		if (annotate && line->cr)	/* the line ending stays as it was */
+			*q++ = '\r';
+		*q++ = '\n';
+
+		job->out_len = q - job->out;
+	}
+}
+
+static void job_run(struct oui_job *job)
+{
+	job_find_macs(job);
+
+	if (job->n_macs > 0) {
+		job->vendors = xrealloc(job->vendors, job->macs_size * sizeof(*job->vendors));
+		job->lens = xrealloc(job->lens, job->macs_size * sizeof(*job->lens));
+	}
+	job->found = vendor_db_lookup_macs(dbs, n_dbs, job->macs[0], sizeof(*job->macs),
+					   job->n_macs, job->vendors, job->lens);
+
+	job_format(job);
+}
+
+static void *worker(void *arg)
+{
+	(void) arg;
+
+	pthread_mutex_lock(&jobs_lock);
+	for (;;) {
+		struct oui_job *job;
+
+		while (jobs_taken == jobs_filled && !jobs_end)
+			pthread_cond_wait(&jobs_work, &jobs_lock);
+		if (jobs_taken == jobs_filled)
+			break;
+		job = &jobs[jobs_taken++ % n_jobs];
+		pthread_mutex_unlock(&jobs_lock);
+
+		job_run(job);
+
+		pthread_mutex_lock(&jobs_lock);
+		job->state = JOB_DONE;
+		pthread_cond_broadcast(&jobs_state);
+	}
+	pthread_mutex_unlock(&jobs_lock);
+
+	return NULL;
+}
+
+/*
+ * The input, as one stream of lines
+ */
+
+static char **files;
+static int n_files, next_file;
+static int in_fd = -1;
+static const char *in_name;
+static char *carry;			/* the part of a line the last block ended in */
+static size_t carry_len, carry_size;
+static int input_failed;		/* a file could not be opened or read */
+
+/* Opens the next file; returns 0 when there is none. */
+
+static int next_input(void)
+{
+	if (n_files == 0 && next_file++ == 0) {
+		in_fd = 0, in_name = "stdin";
+		return 1;
+	}
+
+	while (next_file < n_files) {
+		in_name = files[next_file++];
+		if (strcmp(in_name, "-") == 0) {
+			in_fd = 0, in_name = "stdin";
+			return 1;
+		}
+		if ((in_fd = open(in_name, O_RDONLY)) >= 0)
+			return 1;
+		fprintf(stderr, "%s: %s\n", in_name, strerror(errno));
+		input_failed = 1;
+	}
+
+	return 0;
+}
+
+/* Fills job with at least OUI_BLOCK bytes of whole lines, fewer at the end
+   of the input or when a read comes up short, so that lines arriving slowly
+   through a pipe (tail -f) are not held back. Returns 0 if there was nothing
+   left. */
+
+static int read_block(struct oui_job *job)
+{
+	size_t len = carry_len, cut;
+	const char *nl;
+	int more = 1;
+
+	if (job->in_size < OUI_BLOCK + 1 || job->in_size < carry_len + 1) {
+		job->in_size = carry_len + 1 > OUI_BLOCK + 1 ? 2 * carry_len : OUI_BLOCK + 1;
+		job->in = xrealloc(job->in, job->in_size);
+	}
+	if (carry_len)
+		memcpy(job->in, carry, carry_len);
+
+	for (;;) {
+		size_t want;
+		ssize_t r;
+
+		if (len >= OUI_BLOCK && memchr(job->in + carry_len, '\n', len - carry_len))
+			break;
+		if (len + 1 >= job->in_size) {	/* one line longer than a block */
+			job->in_size *= 2;
+			job->in = xrealloc(job->in, job->in_size);
+		}
+		if (in_fd < 0 && !next_input()) {
+			more = 0;
+			break;
+		}
+
+		/* one byte is kept for the newline a file may end without */
+		want = job->in_size - 1 - len;
+		r = read(in_fd, job->in + len, want);
+		if (r < 0) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "%s: %s\n", in_name, strerror(errno));
+			input_failed = 1;
+		}
+		if (r <= 0) {
+			if (in_fd > 0)
+				close(in_fd);
+			in_fd = -1;
+			if (len > 0 && job->in[len - 1] != '\n')
+				job->in[len++] = '\n';
+			continue;
+		}
+		len += r;
+		if ((size_t) r < want && memchr(job->in + carry_len, '\n', len - carry_len))
+			break;
+	}
+
+	nl = memrchr(job->in, '\n', len);
+	cut = more && nl ? (size_t) (nl + 1 - job->in) : len;
+
+	carry_len = len - cut;
+	if (carry_len > carry_size) {
+		carry_size = 2 * carry_len;
+		carry = xrealloc(carry, carry_size);
+	}
+	memcpy(carry, job->in + cut, carry_len);
+
+	job->in_len = cut;
+	return cut > 0;
+}
+
+/* The writer: the jobs in order, until the reader has come to the end. A
+   block short of OUI_BLOCK means the input is coming in slowly, from a
+   pipe, so it is flushed rather than kept waiting for more. */
+
+static void *writer(void *arg)
+{
+	(void) arg;
+
+	for (size_t seq = 0;; seq++) {
+		struct oui_job *job = &jobs[seq % n_jobs];
+		int done;
+
+		pthread_mutex_lock(&jobs_lock);
+		while (job->state != JOB_DONE && !(jobs_end && seq == jobs_filled))
+			pthread_cond_wait(&jobs_state, &jobs_lock);
+		done = job->state == JOB_DONE;
+		pthread_mutex_unlock(&jobs_lock);
+
+		if (!done)
+			break;
+
+		if (job->out_len && fwrite(job->out, 1, job->out_len, stdout) != job->out_len) {
+			perror("stdout");
+			exit(1);
+		}
+		if (job->in_len < OUI_BLOCK)
+			fflush(stdout);
+		total_lines += job->n_input, total_macs += job->n_macs, total_found += job->found;
+
+		pthread_mutex_lock(&jobs_lock);
+		job->state = JOB_EMPTY;
+		pthread_cond_broadcast(&jobs_state);
+		pthread_mutex_unlock(&jobs_lock);
+	}
+
+	return NULL;
+}
+
+int main (int argc, char *argv[])
+{
+	const char *vendors = NULL, *local = NULL;
+	struct vendor_db *db = NULL, *local_db = NULL;
+	pthread_t threads[OUI_MAX_THREADS], write_thread;
+	long n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	int stats = 0, opt;
+	uint64_t t0;
+
+	while ((opt = getopt(argc, argv, "asj:v:l:")) != -1) {
+		switch (opt) {
+		case 'a':
+			annotate = 1;
+			break;
+		case 's':
+			stats = 1;
+			break;
+		case 'j':
+			n_threads = atol(optarg);
+			break;
+		case 'v':
+			vendors = optarg;
+			break;
+		case 'l':
+			local = optarg;
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-a] [-s] [-j threads] [-v vendors] [-l local-vendors] [file ...]\n", argv[0]);
+			exit(1);
+		}
+	}
+	files = argv + optind;
+	n_files = argc - optind;
+
+	if (n_threads < 1)
+		n_threads = 1;
+	if (n_threads > OUI_MAX_THREADS)
+		n_threads = OUI_MAX_THREADS;
+
+	if (local) {
+		if (!(local_db = vendor_db_open(local))) {
+			fprintf(stderr, "%s: Problem loading mac vendors list.\n", local);
+			exit(1);
+		}
+		dbs[n_dbs++] = local_db;
+	}
+	if (vendors)
+		db = vendor_db_open(vendors);
+	else
+		db = vendor_db_open_image(mac_vendors_db, mac_vendors_db_end - mac_vendors_db);
+	if (!db) {
+		fprintf(stderr, "%s: Problem loading mac vendors list.\n", vendors ? vendors : argv[0]);
+		exit(1);
+	}
+	dbs[n_dbs++] = db;
+
+	setvbuf(stdout, NULL, _IOFBF, OUI_BLOCK);
+
+	n_jobs = n_threads * OUI_JOBS_PER_THREAD;
+	jobs = calloc(n_jobs, sizeof(*jobs));
+	if (!jobs) {
+		perror("calloc");
+		exit(1);
+	}
+	for (long i = 0; i < n_threads; i++)
+		if (pthread_create(&threads[i], NULL, worker, NULL) != 0) {
+			fprintf(stderr, "%s: Cannot start the worker threads.\n", argv[0]);
+			exit(1);
+		}
+	if (pthread_create(&write_thread, NULL, writer, NULL) != 0) {
+		fprintf(stderr, "%s: Cannot start the writer thread.\n", argv[0]);
+		exit(1);
+	}
+
+	t0 = clock_ns();
+
+	for (size_t seq = 0;; seq++) {
+		struct oui_job *job = &jobs[seq % n_jobs];
+		int filled;
+
+		pthread_mutex_lock(&jobs_lock);
+		while (job->state != JOB_EMPTY)
+			pthread_cond_wait(&jobs_state, &jobs_lock);
+		pthread_mutex_unlock(&jobs_lock);
+
+		filled = read_block(job);
+
+		pthread_mutex_lock(&jobs_lock);
+		if (filled) {
+			job->state = JOB_FILLED;
+			jobs_filled++;
+			pthread_cond_signal(&jobs_work);
+		} else {
+			jobs_end = 1;
+			pthread_cond_broadcast(&jobs_work);
+			pthread_cond_broadcast(&jobs_state);
+		}
+		pthread_mutex_unlock(&jobs_lock);
+
+		if (!filled)
+			break;
+	}
+
+	pthread_join(write_thread, NULL);
+	for (long i = 0; i < n_threads; i++)
+		pthread_join(threads[i], NULL);
+
+	if (fflush(stdout) != 0) {
+		perror("stdout");
+		exit(1);
+	}
+
+	if (stats) {
+		double s = (clock_ns() - t0) / 1e9;
+
+		fprintf(stderr, "%zu lines, %zu MACs, %zu with a known vendor in %.3f s: %.1f M MACs/s on %ld threads.\n",
+			total_lines, total_macs, total_found, s, s > 0 ? total_macs / s / 1e6 : 0.0, n_threads);
+	}
+
+	vendor_db_close(local_db);
+	vendor_db_close(db);
+
+	return input_failed;
+}